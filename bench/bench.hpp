@@ -0,0 +1,171 @@
+#pragma once
+
+// Minimal benchmark harness shared by the benchmark programs.
+//
+// Each case is timed in batches until it has run for --min-time-ms; the
+// per-operation time of every batch is one sample for the percentiles.
+// Cases that measure latency themselves hand their samples to report().
+// Results go to stdout (or --output FILE) as one JSON document, so two
+// builds can be compared with any JSON tool; a readable table goes to
+// stderr.
+//
+//     bench::Suite suite("micro", argc, argv);
+//     suite.run("gpio_read", [&] { gpio.read(5, value); });
+//     return suite.finish();
+
+#include <algorithm>
+#include <boost/json.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bench {
+
+// Keeps the compiler from discarding a result that is never used
+template <typename T>
+inline void keep(T&& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+inline double percentile(std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t rank = static_cast<size_t>(p / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+class Suite {
+  public:
+    Suite(std::string name, int argc, char** argv) : name_(std::move(name)) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            auto value = [&]() -> std::string {
+                if (i + 1 >= argc) usage_(argv[0]);
+                return argv[++i];
+            };
+            if (arg == "--filter") filter_ = value();
+            else if (arg == "--min-time-ms") min_time_ms_ = std::atof(value().c_str());
+            else if (arg == "--output") output_ = value();
+            else if (arg.rfind("--", 0) == 0 && arg.find('=') != std::string::npos) {
+                // --key=value, left for the program to read with option()
+                options_[arg.substr(2, arg.find('=') - 2)] = arg.substr(arg.find('=') + 1);
+            } else usage_(argv[0]);
+        }
+    }
+
+    bool enabled(const std::string& name) const {
+        return filter_.empty() || name.find(filter_) != std::string::npos;
+    }
+
+    double option(const std::string& key, double fallback) const {
+        auto it = options_.find(key);
+        return it == options_.end() ? fallback : std::atof(it->second.c_str());
+    }
+
+    std::string text_option(const std::string& key, const std::string& fallback) const {
+        auto it = options_.find(key);
+        return it == options_.end() ? fallback : it->second;
+    }
+
+    double min_time_ms() const { return min_time_ms_; }
+
+    template <typename Fn>
+    void run(const std::string& name, Fn&& fn) {
+        if (!enabled(name)) return;
+        using clock = std::chrono::steady_clock;
+
+        // size batches to ~100 us so the clock reads don't dominate
+        uint64_t batch = 1;
+        while (true) {
+            auto start = clock::now();
+            for (uint64_t i = 0; i < batch; i++) fn();
+            double ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+            if (ns > 100000 || batch >= (1u << 24)) break;
+            batch *= 2;
+        }
+
+        std::vector<double> samples;
+        uint64_t ops = 0;
+        double total_ns = 0;
+        while (total_ns < min_time_ms_ * 1e6 || samples.size() < 10) {
+            auto start = clock::now();
+            for (uint64_t i = 0; i < batch; i++) fn();
+            double ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+            samples.push_back(ns / batch);
+            ops += batch;
+            total_ns += ns;
+        }
+        report(name, ops, total_ns / 1e9, std::move(samples));
+    }
+
+    // samples_ns are per-operation times or latencies, in any order
+    void report(const std::string& name, uint64_t ops, double seconds, std::vector<double> samples_ns,
+                std::map<std::string, double> extra = {}) {
+        std::sort(samples_ns.begin(), samples_ns.end());
+        boost::json::object r;
+        r["name"] = name;
+        r["ops"] = ops;
+        r["seconds"] = seconds;
+        r["ops_per_s"] = seconds > 0 ? ops / seconds : 0;
+        r["samples"] = samples_ns.size();
+        double mean = 0;
+        for (double s : samples_ns) mean += s;
+        r["mean_ns"] = samples_ns.empty() ? 0 : mean / samples_ns.size();
+        r["min_ns"] = samples_ns.empty() ? 0 : samples_ns.front();
+        r["p50_ns"] = percentile(samples_ns, 50);
+        r["p90_ns"] = percentile(samples_ns, 90);
+        r["p99_ns"] = percentile(samples_ns, 99);
+        r["p999_ns"] = percentile(samples_ns, 99.9);
+        r["max_ns"] = samples_ns.empty() ? 0 : samples_ns.back();
+        for (const auto& [key, value] : extra) r[key] = value;
+
+        std::fprintf(stderr, "%-40s %12.0f ops/s  p50 %10.1f ns  p99 %10.1f ns  max %10.1f ns\n",
+                     name.c_str(), r["ops_per_s"].as_double(), r["p50_ns"].as_double(),
+                     r["p99_ns"].as_double(), r["max_ns"].as_double());
+        results_.push_back(std::move(r));
+    }
+
+    // Writes the results, returns the process exit code
+    int finish() {
+        boost::json::object doc;
+        doc["suite"] = name_;
+        doc["timestamp"] = std::chrono::duration_cast<std::chrono::seconds>(
+                               std::chrono::system_clock::now().time_since_epoch())
+                               .count();
+#ifdef NDEBUG
+        doc["build"] = "release";
+#else
+        doc["build"] = "debug";
+#endif
+        doc["results"] = std::move(results_);
+        std::string text = boost::json::serialize(doc);
+        if (output_.empty()) {
+            std::cout << text << std::endl;
+        } else {
+            std::ofstream(output_) << text << std::endl;
+        }
+        return 0;
+    }
+
+  private:
+    [[noreturn]] static void usage_(const char* program) {
+        std::fprintf(stderr, "usage: %s [--filter SUBSTRING] [--min-time-ms MS] [--output FILE] [--key=value ...]\n",
+                     program);
+        std::exit(2);
+    }
+
+    std::string name_;
+    std::string filter_;
+    std::string output_;
+    double min_time_ms_ = 200;
+    std::map<std::string, std::string> options_;
+    boost::json::array results_;
+};
+
+} // namespace bench
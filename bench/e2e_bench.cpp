@@ -0,0 +1,209 @@
+// End-to-end benchmark: runs the real novaGround binary on the simulated HAL
+// against an in-process MQTT stand-in, and measures both directions.
+//
+//   telemetry: sample timestamp -> telemetry message arriving at the broker
+//   commands:  command published by the broker -> GPIO output change (the
+//              simulated chip loops output 17 back to input 5, whose edge is
+//              timestamped on CLOCK_REALTIME) -> edge event back at the broker
+//
+//     e2e_bench --binary=build/novaGround [--rate=1000] [--duration-s=5]
+//               [--publish-period-ms=5] [--sample-period-us=1000]
+//               [--daq-latency-us=20]
+
+#include "bench.hpp"
+#include "mqtt_stand_in.hpp"
+
+#include <csignal>
+#include <deque>
+#include <map>
+#include <sys/wait.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr const char* kCommandTopic = "e2e/command";
+constexpr const char* kTelemetryTopic = "e2e/telemetry";
+constexpr const char* kGpioTopic = "e2e/gpio";
+constexpr int kOutputPin = 17;
+constexpr int kInputPin = 5;
+
+uint64_t realtime_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+uint64_t to_ns(std::chrono::system_clock::time_point t) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+}
+
+std::string write_config(uint16_t port, const bench::Suite& suite) {
+    boost::json::object sim;
+    sim["gpio_loopback"] = boost::json::object{{std::to_string(kOutputPin), kInputPin}};
+    sim["daq"] = boost::json::object{{"latency_us", suite.option("daq-latency-us", 20)}, {"jitter_us", 0}};
+
+    boost::json::object config;
+    config["hal"] = boost::json::object{{"backend", "sim"}, {"sim", sim}};
+    config["daq"] = boost::json::object{{"sample_period_us", suite.option("sample-period-us", 1000)}};
+    config["gpio"] = boost::json::object{{"outputs", boost::json::array{kOutputPin}},
+                                         {"inputs", boost::json::array{kInputPin}},
+                                         {"event_clock", "realtime"}};
+    config["mqtt"] = boost::json::object{{"address", "tcp://127.0.0.1:" + std::to_string(port)},
+                                         {"client_id", "novaground-e2e"},
+                                         {"command_topic", kCommandTopic},
+                                         {"telemetry_topic", kTelemetryTopic},
+                                         {"gpio_topic", kGpioTopic}};
+    config["publish_period_ms"] = suite.option("publish-period-ms", 5);
+    config["log_levels"] = "warn";
+
+    char path[] = "/tmp/novaground-e2e-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) throw std::runtime_error("cannot create config file");
+    std::string text = boost::json::serialize(config);
+    (void)write(fd, text.data(), text.size());
+    close(fd);
+    return path;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    bench::Suite suite("e2e", argc, argv);
+    const std::string binary = suite.text_option("binary", "");
+    const double rate = suite.option("rate", 1000);
+    const double duration_s = suite.option("duration-s", 5);
+    if (binary.empty() || rate <= 0) {
+        std::fprintf(stderr, "e2e_bench: --binary=PATH to novaGround is required\n");
+        return 2;
+    }
+
+    MqttStandIn broker;
+    const uint16_t port = broker.start();
+
+    // everything below is touched by the broker thread through the tap
+    std::mutex mutex;
+    bool measuring = false;
+    struct Pending {
+        uint64_t sent_ns;
+        int level;
+    };
+    std::deque<Pending> pending;
+    std::map<std::pair<int, int>, double> newest_sample; // (hat, channel) -> ms
+    std::vector<double> sample_latency, telemetry_interval, actuator_latency, round_trip;
+    uint64_t telemetry_messages = 0, telemetry_bytes = 0, samples = 0, edges = 0, unmatched = 0;
+    uint64_t last_telemetry_ns = 0;
+
+    broker.set_tap([&](const std::string& topic, const std::string& payload,
+                       std::chrono::system_clock::time_point received) {
+        boost::system::error_code ec;
+        boost::json::value doc = boost::json::parse(payload, ec);
+        if (ec || !doc.is_object()) return;
+        const uint64_t received_ns = to_ns(received);
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (topic == kTelemetryTopic) {
+            // the publisher resends the latest snapshot every period, only
+            // the first sighting of each sample counts
+            for (const auto& item : doc.at("sensors").as_array()) {
+                const auto& sd = item.as_object();
+                auto key = std::make_pair(int(sd.at("hat_id").as_int64()), int(sd.at("channel_id").as_int64()));
+                double t = sd.at("timestamp").to_number<double>();
+                double& newest = newest_sample[key];
+                if (t <= newest) continue;
+                newest = t;
+                if (!measuring) continue;
+                samples++;
+                sample_latency.push_back(received_ns - t * 1e6);
+            }
+            if (measuring) {
+                telemetry_messages++;
+                telemetry_bytes += payload.size();
+                if (last_telemetry_ns) telemetry_interval.push_back(received_ns - last_telemetry_ns);
+            }
+            last_telemetry_ns = received_ns;
+        } else if (topic == kGpioTopic) {
+            const auto& e = doc.as_object();
+            if (e.at("pin_id").as_int64() != kInputPin) return;
+            int level = int(e.at("state").as_int64());
+            uint64_t edge_ns = e.at("timestamp_ns").to_number<uint64_t>();
+            // commands toggle the level, so the oldest pending command with
+            // this level caused the edge; older ones were coalesced
+            while (!pending.empty() && pending.front().level != level) {
+                pending.pop_front();
+                unmatched++;
+            }
+            if (pending.empty()) return;
+            Pending command = pending.front();
+            pending.pop_front();
+            edges++;
+            actuator_latency.push_back(double(edge_ns) - double(command.sent_ns));
+            round_trip.push_back(double(received_ns) - double(command.sent_ns));
+        }
+    });
+
+    const std::string config_path = write_config(port, suite);
+    pid_t child = fork();
+    if (child == 0) {
+        execl(binary.c_str(), binary.c_str(), config_path.c_str(), (char*)nullptr);
+        std::perror("exec novaGround");
+        _exit(127);
+    }
+
+    int status = 0;
+    if (!broker.wait_for_subscriber(kCommandTopic, std::chrono::seconds(10))) {
+        std::fprintf(stderr, "e2e_bench: novaGround did not subscribe within 10 s\n");
+        kill(child, SIGKILL);
+        waitpid(child, &status, 0);
+        unlink(config_path.c_str());
+        return 1;
+    }
+
+    // let the sampler, publisher and GPIO monitor settle
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        measuring = true;
+    }
+
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+    const auto period = std::chrono::duration<double>(1.0 / rate);
+    uint64_t sent = 0;
+    int level = 0;
+    while (clock::now() - start < std::chrono::duration<double>(duration_s)) {
+        std::this_thread::sleep_until(start + std::chrono::duration_cast<clock::duration>(period * sent));
+        level ^= 1;
+        std::string command = R"({"type": "gpio", "id": )" + std::to_string(kOutputPin) +
+                              R"(, "state": )" + std::to_string(level) + "}";
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.push_back({realtime_ns(), level});
+        }
+        broker.publish(kCommandTopic, command, 1);
+        sent++;
+    }
+    const double seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+    // drain whatever is still in flight
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    kill(child, SIGTERM);
+    waitpid(child, &status, 0);
+    broker.stop();
+    unlink(config_path.c_str());
+
+    std::lock_guard<std::mutex> lock(mutex);
+    suite.report("telemetry/sample_to_broker", samples, seconds, std::move(sample_latency),
+                 {{"messages", double(telemetry_messages)},
+                  {"messages_per_s", telemetry_messages / seconds},
+                  {"bytes_per_s", telemetry_bytes / seconds}});
+    suite.report("telemetry/interval", telemetry_messages, seconds, std::move(telemetry_interval));
+    suite.report("command/to_actuator", edges, seconds, std::move(actuator_latency),
+                 {{"sent", double(sent)},
+                  {"offered_per_s", sent / seconds},
+                  {"coalesced", double(unmatched)},
+                  {"unanswered", double(pending.size())}});
+    suite.report("command/round_trip", edges, seconds, std::move(round_trip));
+    return suite.finish();
+}
@@ -0,0 +1,220 @@
+// Microbenchmarks of the ground station's hot paths against simulated
+// devices with no modelled latency, so the numbers are the code's own cost.
+//
+//     meson test -C build --benchmark --suite micro   (or run micro_bench directly)
+
+#include "bench.hpp"
+#include "pipeline.hpp"
+#include "control/servo_calibration.hpp"
+#include "hal/sim_pwm_driver.hpp"
+#include "logging/log.hpp"
+
+#include <atomic>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+HalSettings bench_hal() {
+    HalSettings hal;
+    hal.backend = "sim";
+    hal.sim.hats = {0, 1, 2, 3};
+    hal.sim.i2c_hz = 0;
+    hal.sim.daq = {};
+    hal.sim.i2c = {};
+    hal.sim.gpio = {};
+    return hal;
+}
+
+// Opens every simulated device into the pipeline globals, the way main()
+// does for the real ones
+std::vector<int> open_devices(const RuntimeConfig& config) {
+    hal_settings = config.hal;
+    analog_input = make_analog_input(hal_settings);
+    std::vector<int> daq_hats = analog_input->open();
+    has_daq = !daq_hats.empty();
+
+    std::vector<ServoBoardConfig> boards(2);
+    boards[1].address = 0x41;
+    has_servo = servoBank.begin(boards, [](uint8_t address) {
+                    return make_pwm_driver(hal_settings, address);
+                }) > 0;
+    servoMotion = std::make_unique<ServoMotion>(servoBank);
+    servoMotion->set_observer(publish_servo_outputs);
+    controlLoops = std::make_unique<ControlLoops>(*servoMotion);
+
+    io_expander = make_relay_expander(hal_settings, config.relay.bus, config.relay.address);
+    has_io_expander = true;
+
+    gpio_manager = std::make_unique<GPIO_Manager>(make_gpio(hal_settings, config.gpio.chip));
+    has_gpio_manager = true;
+    configure_gpio(config.gpio);
+    gpio_manager->set_counter(6, GPIO_CounterConfig{});
+    return daq_hats;
+}
+
+double now_ms() {
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    bench::Suite suite("micro", argc, argv);
+    if (const char* levels = std::getenv("NOVAGROUND_LOG")) {
+        logging::set_levels(levels);
+    } else {
+        logging::set_level(logging::Level::kWarn);
+    }
+
+    auto config = std::make_shared<RuntimeConfig>();
+    config->hal = bench_hal();
+    runtime_config.swap(config);
+    std::vector<int> daq_hats = open_devices(*config);
+    sample_once(daq_hats, *config);
+
+    // ———— telemetry serialization ————
+    uint64_t seq = 0;
+    suite.run("telemetry_serialize", [&] { bench::keep(serialize_telemetry(++seq)); });
+
+    // ———— command parsing and dispatch ————
+    const std::string servo_cmd = R"({"type": "servo", "id": 3, "angle": 1500})";
+    const std::string relay_cmd = R"({"type": "relay", "id": 4, "state": 1})";
+    const std::string gpio_cmd = R"({"type": "gpio", "id": 17, "state": 1})";
+    const std::string gpio_many_cmd = R"({"type": "gpio", "states": {"17": 1, "27": 0, "22": 1}})";
+    auto dispatch = [](const std::string& cmd) {
+        dispatch_command(nullptr, "novaground/command", cmd, *io_expander, servoBank, *servoMotion,
+                         *gpio_manager);
+    };
+    suite.run("command_parse", [&] {
+        boost::system::error_code ec;
+        bench::keep(boost::json::parse(servo_cmd, ec));
+    });
+    suite.run("command_dispatch/servo", [&] { dispatch(servo_cmd); });
+    suite.run("command_dispatch/relay", [&] { dispatch(relay_cmd); });
+    suite.run("command_dispatch/gpio", [&] { dispatch(gpio_cmd); });
+    suite.run("command_dispatch/gpio_states", [&] { dispatch(gpio_many_cmd); });
+
+    // ———— GPIO_Manager lookups ————
+    int value = 0;
+    suite.run("gpio_read", [&] { bench::keep(gpio_manager->read(5, value)); });
+    suite.run("gpio_write", [&] { bench::keep(gpio_manager->write(17, value ^= 1)); });
+    suite.run("gpio_read_all_inputs", [] { bench::keep(gpio_manager->read_all_inputs()); });
+    suite.run("gpio_read_counters", [] { bench::keep(gpio_manager->read_counters()); });
+
+    // ———— servo conversion math ————
+    ServoCalibration calibration;
+    calibration.units = ServoUnits::kAngle;
+    calibration.input_min = 0;
+    calibration.input_max = 180;
+    calibration.resolution = 0.1;
+    ServoCalibrationTable table;
+    table.build(calibration, FREQUENCY_OSCILLATOR, servoBank.board(0).readPrescale());
+    double angle = 0;
+    suite.run("servo_calibration_ticks", [&] {
+        bench::keep(table.ticks(angle));
+        angle = angle >= 180 ? 0 : angle + 0.37;
+    });
+    SimPwmDriver pwm(config->hal.sim);
+    pwm.begin();
+    pwm.setPWMFreq(50);
+    uint16_t pulse = 500;
+    suite.run("pwm_write_microseconds", [&] {
+        pwm.writeMicroseconds(pulse & 15, pulse);
+        pulse = pulse >= 2500 ? 500 : pulse + 7;
+    });
+    std::vector<ServoBank::Update> updates;
+    for (int id = 0; id < 32; id++) updates.push_back({id, uint16_t(200 + id)});
+    suite.run("servo_bank_write/32", [&] {
+        for (auto& u : updates) u.ticks ^= 1;
+        servoBank.write(updates.data(), updates.size());
+    });
+
+    // ———— sampler to publisher handoff ————
+    suite.run("sample_pass/32ch", [&] { sample_once(daq_hats, *config); });
+    if (suite.enabled("sampler_publisher_handoff")) {
+        // the sampler runs flat out; the reader stands in for the publisher
+        // and records how old the newest sample is when it first sees it
+        std::atomic<bool> stop{false};
+        std::thread sampler([&] {
+            while (!stop) sample_once(daq_hats, *config);
+        });
+        std::vector<double> latencies;
+        double last = 0;
+        uint64_t reads = 0;
+        auto start = std::chrono::steady_clock::now();
+        auto until = start + std::chrono::duration<double, std::milli>(suite.min_time_ms());
+        while (std::chrono::steady_clock::now() < until) {
+            double newest = 0;
+            const SensorState sensors = device_state.sensors.read();
+            for (uint32_t i = 0; i < sensors.count; i++) newest = std::max(newest, sensors.samples[i].time);
+            reads++;
+            if (newest > last) {
+                latencies.push_back((now_ms() - newest) * 1e6);
+                last = newest;
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        stop = true;
+        sampler.join();
+        uint64_t handoffs = latencies.size();
+        suite.report("sampler_publisher_handoff", handoffs, seconds, std::move(latencies),
+                     {{"reader_polls", double(reads)}});
+    }
+
+    // ———— black box ————
+    if (suite.enabled("recorder_samples/32ch")) {
+        char dir[] = "/tmp/novaground-rec-XXXXXX";
+        if (mkdtemp(dir)) {
+            RecorderSettings settings;
+            settings.dir = dir;
+            std::string path;
+            {
+                BlackBox box(settings, run_id);
+                path = box.path();
+                sample_once(daq_hats, *config);
+                const SensorState sensors = device_state.sensors.read();
+                const std::vector<sensor_datapoint> pass(sensors.samples, sensors.samples + sensors.count);
+                suite.run("recorder_samples/32ch", [&] { box.record_samples(pass); });
+                if (box.dropped()) {
+                    logging::warn(logging::Module::kMain, "recorder_samples: file filled up, lower --min-time-ms");
+                }
+            }
+            unlink(path.c_str());
+            rmdir(dir);
+        }
+    }
+
+    // ———— telemetry spool ————
+    if (suite.enabled("spool_append") || suite.enabled("spool_replay")) {
+        char dir[] = "/tmp/novaground-spool-XXXXXX";
+        if (mkdtemp(dir)) {
+            SpoolSettings settings;
+            settings.dir = dir;
+            settings.segments = 4;
+            TelemetrySpool spool(settings);
+            const std::string topic = config->mqtt.telemetry_topic;
+            const std::string frame = serialize_telemetry(1);
+            const TelemetrySpool::Sender accept = [](const std::vector<TelemetrySpool::Frame>& frames) {
+                return frames.size();
+            };
+            // the ring wraps during the run, so this includes reusing segments
+            suite.run("spool_append", [&] { bench::keep(spool.append(topic, frame)); });
+            suite.run("spool_replay", [&] {
+                if (spool.empty()) spool.append(topic, frame);
+                bench::keep(spool.replay(1, accept));
+            });
+            for (uint32_t i = 0; i < settings.segments; i++) {
+                char name[64];
+                snprintf(name, sizeof(name), "%s/segment-%03u.spool", dir, i);
+                unlink(name);
+            }
+            rmdir(dir);
+        }
+    }
+
+    logging::flush();
+    return suite.finish();
+}
@@ -0,0 +1,295 @@
+#include "mqtt_stand_in.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+enum PacketType : uint8_t {
+    kConnect = 1,
+    kConnack = 2,
+    kPublish = 3,
+    kPuback = 4,
+    kPubrec = 5,
+    kPubrel = 6,
+    kPubcomp = 7,
+    kSubscribe = 8,
+    kSuback = 9,
+    kUnsubscribe = 10,
+    kUnsuback = 11,
+    kPingreq = 12,
+    kPingresp = 13,
+    kDisconnect = 14,
+};
+
+std::string encode_length(size_t length) {
+    std::string out;
+    do {
+        uint8_t byte = length % 128;
+        length /= 128;
+        if (length) byte |= 0x80;
+        out.push_back(static_cast<char>(byte));
+    } while (length);
+    return out;
+}
+
+std::string packet(uint8_t header, const std::string& body) {
+    return static_cast<char>(header) + encode_length(body.size()) + body;
+}
+
+std::string u16(uint16_t v) {
+    return {static_cast<char>(v >> 8), static_cast<char>(v & 0xFF)};
+}
+
+uint16_t read_u16(const std::string& s, size_t pos) {
+    return (uint8_t(s[pos]) << 8) | uint8_t(s[pos + 1]);
+}
+
+// topic filters and topics split on '/'
+std::vector<std::string> levels(const std::string& s) {
+    std::vector<std::string> out(1);
+    for (char c : s) {
+        if (c == '/') out.emplace_back();
+        else out.back().push_back(c);
+    }
+    return out;
+}
+
+} // namespace
+
+bool MqttStandIn::matches(const std::string& filter, const std::string& topic) {
+    auto f = levels(filter);
+    auto t = levels(topic);
+    for (size_t i = 0; i < f.size(); i++) {
+        if (f[i] == "#") return true;
+        if (i >= t.size()) return false;
+        if (f[i] != "+" && f[i] != t[i]) return false;
+    }
+    return f.size() == t.size();
+}
+
+uint16_t MqttStandIn::start(uint16_t port) {
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int one = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    socklen_t len = sizeof(addr);
+    if (listen_fd_ < 0 || bind(listen_fd_, (sockaddr*)&addr, sizeof(addr)) < 0 ||
+        listen(listen_fd_, 8) < 0 || getsockname(listen_fd_, (sockaddr*)&addr, &len) < 0) {
+        throw std::runtime_error("MQTT stand-in: cannot listen on loopback");
+    }
+    wake_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    running_ = true;
+    thread_ = std::thread(&MqttStandIn::run_, this);
+    return ntohs(addr.sin_port);
+}
+
+void MqttStandIn::stop() {
+    if (!running_.exchange(false)) return;
+    uint64_t one = 1;
+    (void)write(wake_fd_, &one, sizeof(one));
+    thread_.join();
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& client : clients_) {
+        std::lock_guard<std::mutex> send_lock(client->send_mutex);
+        close(client->fd);
+        client->fd = -1;
+    }
+    clients_.clear();
+    close(listen_fd_);
+    close(wake_fd_);
+}
+
+void MqttStandIn::send_(Client& client, const std::string& data) {
+    std::lock_guard<std::mutex> lock(client.send_mutex);
+    size_t sent = 0;
+    while (client.fd >= 0 && sent < data.size()) {
+        ssize_t n = ::send(client.fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) return; // the poll loop notices the dead socket
+        sent += n;
+    }
+}
+
+void MqttStandIn::publish(const std::string& topic, const std::string& payload, int qos) {
+    route_(topic, payload, qos);
+}
+
+void MqttStandIn::route_(const std::string& topic, const std::string& payload, int qos) {
+    std::vector<std::pair<std::shared_ptr<Client>, int>> targets;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& client : clients_) {
+            int granted = -1;
+            for (const auto& [filter, q] : client->filters) {
+                if (matches(filter, topic)) granted = std::max(granted, q);
+            }
+            if (granted >= 0) targets.emplace_back(client, std::min({granted, qos, 1}));
+        }
+    }
+    for (auto& [client, q] : targets) {
+        std::string body = u16(topic.size()) + topic;
+        if (q) {
+            std::lock_guard<std::mutex> lock(client->send_mutex);
+            if (client->next_packet_id == 0) client->next_packet_id = 1;
+            body += u16(client->next_packet_id++);
+        }
+        send_(*client, packet(kPublish << 4 | q << 1, body + payload));
+    }
+}
+
+bool MqttStandIn::wait_for_subscriber(const std::string& topic, std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return subscribed_.wait_for(lock, timeout, [&] {
+        for (const auto& client : clients_) {
+            for (const auto& entry : client->filters) {
+                if (matches(entry.first, topic)) return true;
+            }
+        }
+        return false;
+    });
+}
+
+// false closes the connection
+bool MqttStandIn::handle_packet_(const std::shared_ptr<Client>& client, uint8_t header,
+                                 const std::string& body) {
+    switch (header >> 4) {
+    case kConnect:
+        // accept anyone, never a stored session
+        send_(*client, packet(kConnack << 4, std::string("\0\0", 2)));
+        return true;
+    case kPublish: {
+        int qos = (header >> 1) & 3;
+        uint16_t topic_len = read_u16(body, 0);
+        std::string topic = body.substr(2, topic_len);
+        size_t pos = 2 + topic_len;
+        uint16_t id = 0;
+        if (qos) {
+            id = read_u16(body, pos);
+            pos += 2;
+        }
+        auto received = std::chrono::system_clock::now();
+        std::string payload = body.substr(pos);
+        if (qos == 1) send_(*client, packet(kPuback << 4, u16(id)));
+        if (qos == 2) send_(*client, packet(kPubrec << 4, u16(id)));
+        if (tap_) tap_(topic, payload, received);
+        route_(topic, payload, qos);
+        return true;
+    }
+    case kPubrel:
+        send_(*client, packet(kPubcomp << 4, body.substr(0, 2)));
+        return true;
+    case kPuback:
+    case kPubrec:
+    case kPubcomp:
+        return true; // deliveries are fire and forget here
+    case kSubscribe: {
+        uint16_t id = read_u16(body, 0);
+        std::string granted;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (size_t pos = 2; pos + 2 < body.size();) {
+                uint16_t len = read_u16(body, pos);
+                std::string filter = body.substr(pos + 2, len);
+                int qos = std::min<int>(body[pos + 2 + len] & 3, 1);
+                pos += 3 + len;
+                client->filters.emplace_back(filter, qos);
+                granted.push_back(static_cast<char>(qos));
+            }
+        }
+        subscribed_.notify_all();
+        send_(*client, packet(kSuback << 4, u16(id) + granted));
+        return true;
+    }
+    case kUnsubscribe: {
+        uint16_t id = read_u16(body, 0);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (size_t pos = 2; pos + 1 < body.size();) {
+                uint16_t len = read_u16(body, pos);
+                std::string filter = body.substr(pos + 2, len);
+                pos += 2 + len;
+                std::erase_if(client->filters, [&](const auto& f) { return f.first == filter; });
+            }
+        }
+        send_(*client, packet(kUnsuback << 4, u16(id)));
+        return true;
+    }
+    case kPingreq:
+        send_(*client, packet(kPingresp << 4, ""));
+        return true;
+    case kDisconnect:
+    default:
+        return false;
+    }
+}
+
+void MqttStandIn::run_() {
+    std::vector<pollfd> fds;
+    std::vector<std::shared_ptr<Client>> polled;
+    while (running_) {
+        fds.assign({{listen_fd_, POLLIN, 0}, {wake_fd_, POLLIN, 0}});
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            polled = clients_;
+        }
+        for (const auto& client : polled) fds.push_back({client->fd, POLLIN, 0});
+        if (poll(fds.data(), fds.size(), 100) <= 0) continue;
+
+        if (fds[0].revents & POLLIN) {
+            int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd >= 0) {
+                int one = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                auto client = std::make_shared<Client>();
+                client->fd = fd;
+                std::lock_guard<std::mutex> lock(mutex_);
+                clients_.push_back(client);
+            }
+        }
+        for (size_t i = 0; i < polled.size(); i++) {
+            if (!fds[i + 2].revents) continue;
+            auto& client = polled[i];
+            char buffer[65536];
+            ssize_t n = read(client->fd, buffer, sizeof(buffer));
+            bool alive = n > 0;
+            if (alive) client->rx.append(buffer, n);
+
+            // every complete packet in the buffer
+            while (alive && client->rx.size() >= 2) {
+                size_t length = 0, pos = 1;
+                int shift = 0;
+                bool complete = false;
+                while (pos < client->rx.size() && pos <= 4) {
+                    uint8_t byte = client->rx[pos++];
+                    length |= size_t(byte & 0x7F) << shift;
+                    shift += 7;
+                    if (!(byte & 0x80)) {
+                        complete = true;
+                        break;
+                    }
+                }
+                if (!complete || client->rx.size() < pos + length) break;
+                uint8_t header = client->rx[0];
+                std::string body = client->rx.substr(pos, length);
+                client->rx.erase(0, pos + length);
+                alive = handle_packet_(client, header, body);
+            }
+            if (!alive) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                std::erase(clients_, client);
+                std::lock_guard<std::mutex> send_lock(client->send_mutex);
+                close(client->fd);
+                client->fd = -1;
+            }
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+// Just enough of an MQTT 3.1.1 broker to benchmark novaGround without
+// Mosquitto: CONNECT, SUBSCRIBE/UNSUBSCRIBE with + and # filters, PUBLISH at
+// QoS 0-2 (delivered at QoS 0 or 1), PINGREQ and DISCONNECT, on a loopback
+// TCP port. No retained messages, wills or sessions. Every publish is also
+// handed to an in-process tap, and the harness can publish into the broker
+// directly, so it needs no client library of its own.
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class MqttStandIn {
+  public:
+    // topic, payload, and when the broker finished reading the packet
+    using Tap = std::function<void(const std::string& topic, const std::string& payload,
+                                   std::chrono::system_clock::time_point received)>;
+
+    ~MqttStandIn() { stop(); }
+
+    // Listens on 127.0.0.1:port, 0 picks a free port. Returns the port.
+    uint16_t start(uint16_t port = 0);
+    void stop();
+
+    // Called on the broker thread for every PUBLISH received from a client
+    void set_tap(Tap tap) { tap_ = std::move(tap); }
+
+    // Delivers to every client subscribed to topic, as if a client had
+    // published it
+    void publish(const std::string& topic, const std::string& payload, int qos = 1);
+
+    // Blocks until some client has subscribed to a filter matching topic
+    bool wait_for_subscriber(const std::string& topic, std::chrono::milliseconds timeout);
+
+    static bool matches(const std::string& filter, const std::string& topic);
+
+  private:
+    struct Client {
+        int fd = -1;
+        std::string rx;
+        std::vector<std::pair<std::string, int>> filters; // filter, granted qos
+        std::mutex send_mutex;
+        uint16_t next_packet_id = 1;
+    };
+
+    void run_();
+    bool handle_packet_(const std::shared_ptr<Client>& client, uint8_t header, const std::string& body);
+    void route_(const std::string& topic, const std::string& payload, int qos);
+    static void send_(Client& client, const std::string& packet);
+
+    int listen_fd_ = -1;
+    int wake_fd_ = -1;
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+    Tap tap_;
+
+    std::mutex mutex_; // clients_ and their filters
+    std::condition_variable subscribed_;
+    std::vector<std::shared_ptr<Client>> clients_;
+};
@@ -0,0 +1,345 @@
+#include "config.hpp"
+
+#include <boost/json.hpp>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace json = boost::json;
+
+namespace {
+
+// Thrown for a field of the wrong type or out of range; carries the key path
+struct ConfigError : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+double number(const json::value& v, double min, double max, const std::string& key) {
+    double d;
+    try {
+        d = v.to_number<double>();
+    } catch (const std::exception&) {
+        throw ConfigError(key + ": expected a number");
+    }
+    if (d < min || d > max) {
+        throw ConfigError(key + ": out of range");
+    }
+    return d;
+}
+
+template <typename T>
+void read_number(const json::object& obj, std::string_view key, T& out,
+                 double min, double max, const std::string& path) {
+    if (const json::value* v = obj.if_contains(key)) {
+        out = static_cast<T>(number(*v, min, max, path + std::string(key)));
+    }
+}
+
+void read_string(const json::object& obj, std::string_view key, std::string& out,
+                 const std::string& path) {
+    const json::value* v = obj.if_contains(key);
+    if (!v) return;
+    if (!v->is_string()) {
+        throw ConfigError(path + std::string(key) + ": expected a string");
+    }
+    out = v->as_string().c_str();
+}
+
+void read_ints(const json::object& obj, std::string_view key, std::vector<int>& out,
+               int min, int max, const std::string& path) {
+    const json::value* v = obj.if_contains(key);
+    if (!v) return;
+    if (!v->is_array()) {
+        throw ConfigError(path + std::string(key) + ": expected an array");
+    }
+    std::vector<int> values;
+    for (const auto& item : v->as_array()) {
+        if (!item.is_int64() || item.as_int64() < min || item.as_int64() > max) {
+            throw ConfigError(path + std::string(key) + ": expected integers in [" +
+                              std::to_string(min) + ", " + std::to_string(max) + "]");
+        }
+        values.push_back(static_cast<int>(item.as_int64()));
+    }
+    out = std::move(values);
+}
+
+const json::object* section(const json::object& root, std::string_view key) {
+    const json::value* v = root.if_contains(key);
+    if (!v) return nullptr;
+    if (!v->is_object()) {
+        throw ConfigError(std::string(key) + ": expected an object");
+    }
+    return &v->as_object();
+}
+
+void parse_daq(const json::object& obj, DaqSettings& daq) {
+    read_ints(obj, "channels", daq.channels, 0, 7, "daq.");
+    read_number(obj, "sample_period_us", daq.sample_period_us, 100, 1e7, "daq.");
+
+    const json::value* v = obj.if_contains("calibration");
+    if (!v) return;
+    if (!v->is_object()) {
+        throw ConfigError("daq.calibration: expected an object");
+    }
+    std::map<int, ChannelCalibration> parsed;
+    for (const auto& entry : v->as_object()) {
+        const std::string path = "daq.calibration." + std::string(entry.key());
+        int hat, channel;
+        char end;
+        if (std::sscanf(std::string(entry.key()).c_str(), "%d:%d%c", &hat, &channel, &end) != 2 || hat < 0 ||
+            hat > 7 || channel < 0 || channel > 7) {
+            throw ConfigError(path + ": keys must be \"hat:channel\"");
+        }
+        if (!entry.value().is_object()) {
+            throw ConfigError(path + ": expected an object");
+        }
+        const json::object& cal = entry.value().as_object();
+        ChannelCalibration c;
+        read_string(cal, "name", c.name, path + ".");
+        read_string(cal, "unit", c.unit, path + ".");
+        read_number(cal, "scale", c.scale, -1e9, 1e9, path + ".");
+        read_number(cal, "offset", c.offset, -1e9, 1e9, path + ".");
+        parsed[hat * 8 + channel] = c;
+    }
+    daq.calibration = std::move(parsed);
+}
+
+void parse_relay(const json::object& obj, RelaySettings& relay) {
+    read_string(obj, "bus", relay.bus, "relay.");
+    read_number(obj, "address", relay.address, 0x03, 0x77, "relay.");
+    read_number(obj, "initial_state", relay.initial_state, 0, 0xFFFF, "relay.");
+}
+
+void parse_servo(const json::object& obj, ServoSettings& servo) {
+    const json::value* boards = obj.if_contains("boards");
+    if (!boards) return;
+    if (!boards->is_array()) {
+        throw ConfigError("servo.boards: expected an array");
+    }
+    std::vector<ServoBoardSettings> parsed;
+    for (const auto& item : boards->as_array()) {
+        if (!item.is_object()) {
+            throw ConfigError("servo.boards: expected objects");
+        }
+        const std::string path = "servo.boards[" + std::to_string(parsed.size()) + "].";
+        ServoBoardSettings board;
+        read_number(item.as_object(), "address", board.address, 0x03, 0x77, path);
+        read_number(item.as_object(), "pwm_freq", board.pwm_freq, 1, 3500, path);
+        read_number(item.as_object(), "oscillator_hz", board.oscillator_hz, 0, 5e7, path);
+        parsed.push_back(board);
+    }
+    servo.boards = std::move(parsed);
+}
+
+void parse_gpio(const json::object& obj, GpioSettings& gpio) {
+    read_string(obj, "chip", gpio.chip, "gpio.");
+    read_ints(obj, "outputs", gpio.outputs, 0, 63, "gpio.");
+    read_ints(obj, "inputs", gpio.inputs, 0, 63, "gpio.");
+    read_string(obj, "event_clock", gpio.event_clock, "gpio.");
+    if (gpio.event_clock != "monotonic" && gpio.event_clock != "realtime") {
+        throw ConfigError("gpio.event_clock: expected \"monotonic\" or \"realtime\"");
+    }
+    if (const json::value* debounce = obj.if_contains("debounce_us")) {
+        if (!debounce->is_object()) {
+            throw ConfigError("gpio.debounce_us: expected an object of pin: period");
+        }
+        std::map<int, uint32_t> parsed;
+        for (const auto& entry : debounce->as_object()) {
+            int pin;
+            try {
+                pin = std::stoi(std::string(entry.key()));
+            } catch (const std::exception&) {
+                throw ConfigError("gpio.debounce_us: keys must be pin numbers");
+            }
+            parsed[pin] = static_cast<uint32_t>(
+                number(entry.value(), 0, 1e6, "gpio.debounce_us." + std::to_string(pin)));
+        }
+        gpio.debounce_us = std::move(parsed);
+    }
+}
+
+void parse_connection(const json::object& obj, std::string_view key, MqttConnectionSettings& link) {
+    const std::string path = "mqtt." + std::string(key) + ".";
+    const json::value* v = obj.if_contains(key);
+    if (!v) return;
+    if (!v->is_object()) {
+        throw ConfigError("mqtt." + std::string(key) + ": expected an object");
+    }
+    const json::object& conn = v->as_object();
+    read_number(conn, "max_inflight", link.max_inflight, 1, 65535, path);
+    read_number(conn, "keepalive_s", link.keepalive_s, 1, 3600, path);
+    read_number(conn, "reconnect_min_s", link.reconnect_min_s, 1, 3600, path);
+    read_number(conn, "reconnect_max_s", link.reconnect_max_s, 1, 3600, path);
+    if (link.reconnect_max_s < link.reconnect_min_s) {
+        throw ConfigError(path + "reconnect_max_s: less than reconnect_min_s");
+    }
+}
+
+void parse_mqtt(const json::object& obj, MqttSettings& mqtt) {
+    read_string(obj, "address", mqtt.address, "mqtt.");
+    read_string(obj, "client_id", mqtt.client_id, "mqtt.");
+    read_string(obj, "command_topic", mqtt.command_topic, "mqtt.");
+    read_string(obj, "telemetry_topic", mqtt.telemetry_topic, "mqtt.");
+    read_string(obj, "gpio_topic", mqtt.gpio_topic, "mqtt.");
+    read_string(obj, "backfill_topic", mqtt.backfill_topic, "mqtt.");
+    read_string(obj, "backfill_response_topic", mqtt.backfill_response_topic, "mqtt.");
+    read_number(obj, "qos", mqtt.qos, 0, 2, "mqtt.");
+    parse_connection(obj, "command", mqtt.command);
+    parse_connection(obj, "telemetry", mqtt.telemetry);
+}
+
+void parse_spool(const json::object& obj, SpoolSettings& spool) {
+    read_string(obj, "dir", spool.dir, "spool.");
+    read_number(obj, "segment_mb", spool.segment_mb, 1, 1024, "spool.");
+    read_number(obj, "segments", spool.segments, 2, 4096, "spool.");
+    read_number(obj, "catch_up_per_s", spool.catch_up_per_s, 1, 1e6, "spool.");
+}
+
+void parse_recorder(const json::object& obj, RecorderSettings& recorder) {
+    read_string(obj, "dir", recorder.dir, "recorder.");
+    read_number(obj, "size_mb", recorder.size_mb, 1, 1 << 20, "recorder.");
+    read_number(obj, "checkpoint_ms", recorder.checkpoint_ms, 1, 60000, "recorder.");
+}
+
+SimWaveform parse_waveform(const json::value& v, SimWaveform wave, const std::string& path) {
+    if (!v.is_object()) {
+        throw ConfigError(path + ": expected an object");
+    }
+    const json::object& obj = v.as_object();
+    read_string(obj, "shape", wave.shape, path + ".");
+    if (wave.shape != "sine" && wave.shape != "square" && wave.shape != "triangle" &&
+        wave.shape != "sawtooth" && wave.shape != "constant") {
+        throw ConfigError(path + ".shape: expected sine, square, triangle, sawtooth or constant");
+    }
+    read_number(obj, "amplitude", wave.amplitude, 0, 10, path + ".");
+    read_number(obj, "offset", wave.offset, -10, 10, path + ".");
+    read_number(obj, "frequency_hz", wave.frequency_hz, 0, 1e4, path + ".");
+    read_number(obj, "noise", wave.noise, 0, 10, path + ".");
+    return wave;
+}
+
+void parse_faults(const json::object& obj, std::string_view key, SimFaults& faults) {
+    const std::string path = "hal.sim." + std::string(key) + ".";
+    const json::value* v = obj.if_contains(key);
+    if (!v) return;
+    if (!v->is_object()) {
+        throw ConfigError(path + ": expected an object");
+    }
+    read_number(v->as_object(), "latency_us", faults.latency_us, 0, 1e6, path);
+    read_number(v->as_object(), "jitter_us", faults.jitter_us, 0, 1e6, path);
+    read_number(v->as_object(), "fault_rate", faults.fault_rate, 0, 1, path);
+}
+
+// {"<pin or channel>": {...}} with integer keys
+template <typename T, typename Parse>
+void read_pin_map(const json::object& obj, std::string_view key, std::map<int, T>& out,
+                  const std::string& path, Parse parse) {
+    const json::value* v = obj.if_contains(key);
+    if (!v) return;
+    if (!v->is_object()) {
+        throw ConfigError(path + std::string(key) + ": expected an object");
+    }
+    std::map<int, T> parsed;
+    for (const auto& entry : v->as_object()) {
+        int index;
+        try {
+            index = std::stoi(std::string(entry.key()));
+        } catch (const std::exception&) {
+            throw ConfigError(path + std::string(key) + ": keys must be numbers");
+        }
+        parsed[index] = parse(entry.value(), path + std::string(key) + "." + std::to_string(index));
+    }
+    out = std::move(parsed);
+}
+
+void parse_hal(const json::object& obj, HalSettings& hal) {
+    read_string(obj, "backend", hal.backend, "hal.");
+    if (hal.backend != "hardware" && hal.backend != "sim") {
+        throw ConfigError("hal.backend: expected \"hardware\" or \"sim\"");
+    }
+    const json::value* v = obj.if_contains("sim");
+    if (!v) return;
+    if (!v->is_object()) {
+        throw ConfigError("hal.sim: expected an object");
+    }
+    const json::object& sim_obj = v->as_object();
+    SimSettings& sim = hal.sim;
+    read_ints(sim_obj, "hats", sim.hats, 0, 7, "hal.sim.");
+    read_number(sim_obj, "i2c_hz", sim.i2c_hz, 0, 5e6, "hal.sim.");
+    if (const json::value* wave = sim_obj.if_contains("waveform")) {
+        sim.waveform = parse_waveform(*wave, sim.waveform, "hal.sim.waveform");
+    }
+    read_pin_map(sim_obj, "channels", sim.channels, "hal.sim.",
+                 [&](const json::value& item, const std::string& path) {
+                     return parse_waveform(item, sim.waveform, path);
+                 });
+    read_pin_map(sim_obj, "gpio_inputs", sim.gpio_inputs, "hal.sim.",
+                 [](const json::value& item, const std::string& path) {
+                     if (!item.is_object()) {
+                         throw ConfigError(path + ": expected an object");
+                     }
+                     SimGpioInput input;
+                     read_number(item.as_object(), "frequency_hz", input.frequency_hz, 0, 1e5, path + ".");
+                     read_number(item.as_object(), "phase_deg", input.phase_deg, -360, 360, path + ".");
+                     return input;
+                 });
+    read_pin_map(sim_obj, "gpio_loopback", sim.gpio_loopback, "hal.sim.",
+                 [](const json::value& item, const std::string& path) {
+                     return static_cast<int>(number(item, 0, 63, path));
+                 });
+    parse_faults(sim_obj, "daq", sim.daq);
+    parse_faults(sim_obj, "i2c", sim.i2c);
+    parse_faults(sim_obj, "gpio", sim.gpio);
+}
+
+} // namespace
+
+bool parse_config(std::string_view text, RuntimeConfig& config, std::string& error) {
+    boost::system::error_code ec;
+    json::value doc = json::parse(text, ec);
+    if (ec) {
+        error = "invalid JSON: " + ec.message();
+        return false;
+    }
+    if (!doc.is_object()) {
+        error = "expected a JSON object at the top level";
+        return false;
+    }
+
+    RuntimeConfig parsed = config;
+    try {
+        const json::object& root = doc.as_object();
+        if (const auto* obj = section(root, "daq")) parse_daq(*obj, parsed.daq);
+        if (const auto* obj = section(root, "relay")) parse_relay(*obj, parsed.relay);
+        if (const auto* obj = section(root, "servo")) parse_servo(*obj, parsed.servo);
+        if (const auto* obj = section(root, "gpio")) parse_gpio(*obj, parsed.gpio);
+        if (const auto* obj = section(root, "mqtt")) parse_mqtt(*obj, parsed.mqtt);
+        if (const auto* obj = section(root, "spool")) parse_spool(*obj, parsed.spool);
+        if (const auto* obj = section(root, "recorder")) parse_recorder(*obj, parsed.recorder);
+        if (const auto* obj = section(root, "hal")) parse_hal(*obj, parsed.hal);
+        read_number(root, "publish_period_ms", parsed.publish_period_ms, 1, 60000, "");
+        read_number(root, "history_frames", parsed.history_frames, 1, 1e6, "");
+        read_string(root, "log_levels", parsed.log_levels, "");
+    } catch (const ConfigError& e) {
+        error = e.what();
+        return false;
+    }
+    config = std::move(parsed);
+    return true;
+}
+
+bool load_config(const std::string& path, RuntimeConfig& config, std::string& error) {
+    std::ifstream file(path);
+    if (!file) {
+        error = "cannot open " + path;
+        return false;
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+    if (!parse_config(text.str(), config, error)) {
+        error = path + ": " + error;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "../hal/sim_settings.hpp"
+#include "../spool/spool_settings.hpp"
+#include "../recorder/recorder_settings.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Everything main() used to hard-code. Each section mirrors one device or
+// thread; fields missing from the file keep the defaults below, which are
+// the values the program ran with before the file existed.
+
+// Volts to engineering units for one channel. Samples are published and
+// recorded in volts; the offline tools apply this.
+struct ChannelCalibration {
+    std::string name;   // e.g. "chamber_pressure"; empty = "hat<h>_ch<c>"
+    std::string unit = "V";
+    double scale = 1;
+    double offset = 0;  // value = volts * scale + offset
+
+    bool operator==(const ChannelCalibration&) const = default;
+};
+
+struct DaqSettings {
+    std::vector<int> channels = {0, 1, 2, 3, 4, 5, 6, 7}; // sampled on every hat
+    uint32_t sample_period_us = 1000;
+    std::map<int, ChannelCalibration> calibration; // by hat * 8 + channel, "hat:channel" in the file
+};
+
+struct RelaySettings {
+    std::string bus = "/dev/i2c-1";
+    uint8_t address = 0x20;
+    uint16_t initial_state = 0xFFFF; // bit n = relay n
+};
+
+struct ServoBoardSettings {
+    uint8_t address = 0x40;
+    float pwm_freq = 50;
+    uint32_t oscillator_hz = 0; // 0 = nominal 25 MHz
+
+    bool operator==(const ServoBoardSettings&) const = default;
+};
+
+struct ServoSettings {
+    std::vector<ServoBoardSettings> boards = {ServoBoardSettings{}};
+};
+
+struct GpioSettings {
+    std::string chip = "/dev/gpiochip0";
+    std::vector<int> outputs = {17, 27, 22};
+    std::vector<int> inputs = {5, 6};
+    std::map<int, uint32_t> debounce_us; // per input pin
+    std::string event_clock = "monotonic";
+};
+
+// One broker connection. Commands and telemetry each get their own, so a
+// telemetry backlog never sits in front of a command or its ack.
+struct MqttConnectionSettings {
+    int max_inflight;               // unacknowledged QoS 1/2 messages
+    uint32_t keepalive_s;
+    uint32_t reconnect_min_s = 1;   // automatic reconnect backoff
+    uint32_t reconnect_max_s;
+
+    bool operator==(const MqttConnectionSettings&) const = default;
+};
+
+struct MqttSettings {
+    std::string address = "mqtt://localhost:1883";
+    std::string client_id = "novaground"; // commands; telemetry adds "-telemetry"
+    std::string command_topic = "novaground/command";
+    std::string telemetry_topic = "novaground/telemetry";
+    std::string gpio_topic = "novaground/gpio";
+    // missed telemetry/GPIO frames are requested here and sent back on the
+    // response topic, over the telemetry connection
+    std::string backfill_topic = "novaground/backfill";
+    std::string backfill_response_topic = "novaground/backfill/response";
+    int qos = 1;
+    // short keepalive and backoff so a dead command link is noticed and
+    // restored quickly; telemetry can have more in flight and wait longer
+    MqttConnectionSettings command{.max_inflight = 10, .keepalive_s = 5, .reconnect_max_s = 2};
+    MqttConnectionSettings telemetry{.max_inflight = 100, .keepalive_s = 20, .reconnect_max_s = 10};
+};
+
+struct RuntimeConfig {
+    DaqSettings daq;
+    RelaySettings relay;
+    ServoSettings servo;
+    GpioSettings gpio;
+    MqttSettings mqtt;
+    SpoolSettings spool;
+    RecorderSettings recorder;
+    HalSettings hal;
+    uint32_t publish_period_ms = 5;
+    uint32_t history_frames = 2000; // per stream, kept for backfill requests
+    std::string log_levels; // logging::set_levels() spec, empty = leave as is
+};
+
+// Parses a config document on top of the defaults. Returns false and sets
+// error (with the offending key) if it is not valid; config is then
+// untouched.
+bool parse_config(std::string_view text, RuntimeConfig& config, std::string& error);
+bool load_config(const std::string& path, RuntimeConfig& config, std::string& error);
+
+class ConfigStore {
+    // The live configuration. Threads take a snapshot once per iteration and
+    // use it for the whole iteration; a reload swaps the pointer, so every
+    // reader sees either the old or the new settings, never a mix.
+public:
+    ConfigStore() : current_(std::make_shared<const RuntimeConfig>()) {}
+
+    std::shared_ptr<const RuntimeConfig> get() const { return current_.load(); }
+    // Returns the settings that were replaced
+    std::shared_ptr<const RuntimeConfig> swap(std::shared_ptr<const RuntimeConfig> config) {
+        return current_.exchange(std::move(config));
+    }
+
+private:
+    std::atomic<std::shared_ptr<const RuntimeConfig>> current_;
+};
@@ -0,0 +1,254 @@
+#include "control_loop.hpp"
+#include "realtime.hpp"
+#include "../logging/log.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+void PidController::reset(double output) {
+    terms_ = Terms{};
+    terms_.output = output;
+    derivative_ = 0;
+    primed_ = false;
+}
+
+const PidController::Terms& PidController::update(double setpoint,
+                                                  double measurement,
+                                                  double dt) {
+    const double lo = std::min(gains_.output_min, gains_.output_max);
+    const double hi = std::max(gains_.output_min, gains_.output_max);
+
+    terms_.error = setpoint - measurement;
+    terms_.p = gains_.kp * terms_.error;
+    terms_.ff = gains_.kff * setpoint + gains_.ff_offset;
+
+    if (primed_ && dt > 0) {
+        // derivative on measurement, optionally low-pass filtered
+        double raw = -(measurement - last_measurement_) / dt;
+        double alpha = gains_.derivative_tau > 0
+                           ? dt / (gains_.derivative_tau + dt)
+                           : 1.0;
+        derivative_ += alpha * (raw - derivative_);
+    } else {
+        // bumpless start: preload the integrator with whatever the output
+        // was before the loop took over
+        derivative_ = 0;
+        integral_ = std::clamp(terms_.output, lo, hi) - terms_.p - terms_.ff;
+        primed_ = true;
+    }
+    last_measurement_ = measurement;
+    terms_.d = gains_.kd * derivative_;
+
+    const double unsaturated = terms_.p + integral_ + terms_.d + terms_.ff;
+    terms_.output = std::clamp(unsaturated, lo, hi);
+    terms_.saturated = terms_.output != unsaturated;
+
+    if (gains_.tracking > 0) {
+        // back-calculation: bleed the integrator toward the clamped output
+        integral_ += (gains_.ki * terms_.error +
+                      gains_.tracking * (terms_.output - unsaturated)) *
+                     dt;
+    } else if (!terms_.saturated ||
+               terms_.error * (unsaturated - terms_.output) < 0) {
+        // conditional integration: only integrate out of saturation
+        integral_ += gains_.ki * terms_.error * dt;
+    }
+    terms_.i = integral_;
+    return terms_;
+}
+
+ControlLoop::ControlLoop(const ControlLoopConfig& config, Feedback feedback,
+                         ServoMotion& motion)
+    : motion_(motion), feedback_(std::move(feedback)) {
+    status_.config = config;
+    // unset limits follow the servo's calibration, so an unbounded loop
+    // can't drive the output against an end stop it doesn't know about
+    PidGains& gains = status_.config.gains;
+    if (std::isnan(gains.output_min) || std::isnan(gains.output_max)) {
+        const ServoCalibration calibration = motion_.calibration(config.servo);
+        if (std::isnan(gains.output_min)) gains.output_min = calibration.input_min;
+        if (std::isnan(gains.output_max)) gains.output_max = calibration.input_max;
+    }
+    pid_.set_gains(gains);
+}
+
+ControlLoop::~ControlLoop() {
+    stop();
+    if (enabled_) {
+        motion_.release(status_.config.servo);
+    }
+}
+
+void ControlLoop::start() {
+    if (running_.exchange(true)) {
+        return;
+    }
+    thread_ = std::thread(&ControlLoop::run_, this);
+}
+
+void ControlLoop::stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void ControlLoop::set_enabled(bool enabled) {
+    std::lock_guard<std::mutex> write_lock(write_mutex_);
+    if (enabled == enabled_) {
+        return;
+    }
+    if (enabled) {
+        const double position = motion_.position(status_.config.servo);
+        std::lock_guard<std::mutex> lock(mutex_);
+        pid_.reset(position);
+    } else {
+        motion_.release(status_.config.servo);
+    }
+    enabled_ = enabled;
+}
+
+void ControlLoop::set_setpoint(double setpoint) { setpoint_ = setpoint; }
+
+ControlLoopStatus ControlLoop::status() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ControlLoopStatus status = status_;
+    status.enabled = enabled_;
+    status.setpoint = setpoint_;
+    return status;
+}
+
+void ControlLoop::run_() {
+    using clock = std::chrono::steady_clock;
+
+    if (!make_thread_realtime(20)) {
+        logging::warn(logging::Module::kControl,
+                      "Control loop for servo {} running without real-time priority",
+                      status_.config.servo);
+    }
+
+    const double rate = status_.config.rate_hz > 0 ? status_.config.rate_hz : 100;
+    const auto period = std::chrono::duration_cast<clock::duration>(
+        std::chrono::duration<double>(1.0 / rate));
+    const double dt = 1.0 / rate;
+    const double nominal_us = 1e6 / rate;
+
+    auto next = clock::now() + period;
+    auto last_start = clock::now();
+    uint64_t overruns = 0;
+
+    while (running_) {
+        std::this_thread::sleep_until(next);
+        const auto start = clock::now();
+
+        double measurement = 0;
+        bool feedback_ok = feedback_(measurement);
+
+        // the write is a bus transfer, so it happens outside mutex_ and
+        // status() (the publisher) never waits for it; write_mutex_ keeps a
+        // disable from slipping in between the update and the write
+        std::unique_lock<std::mutex> write_lock(write_mutex_);
+        bool write = false;
+        PidController::Terms terms;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (enabled_ && feedback_ok) {
+                terms = pid_.update(setpoint_, measurement, dt);
+                write = true;
+            } else {
+                terms = pid_.terms();
+            }
+        }
+        if (write) {
+            motion_.write_direct(status_.config.servo, terms.output);
+        }
+        write_lock.unlock();
+
+        const auto end = clock::now();
+        std::lock_guard<std::mutex> lock(mutex_);
+        status_.feedback_ok = feedback_ok;
+        status_.measurement = measurement;
+        status_.terms = terms;
+        status_.period_us =
+            std::chrono::duration<double, std::micro>(start - last_start).count();
+        if (status_.iterations > 0) {
+            status_.max_jitter_us =
+                std::max(status_.max_jitter_us,
+                         std::abs(status_.period_us - nominal_us));
+        }
+        status_.exec_us =
+            std::chrono::duration<double, std::micro>(end - start).count();
+        status_.iterations++;
+        last_start = start;
+
+        next += period;
+        if (next < end) {
+            // missed one or more deadlines, realign instead of bursting
+            auto missed = (end - next) / period + 1;
+            overruns += missed;
+            next += period * missed;
+        }
+        status_.overruns = overruns;
+    }
+}
+
+void ControlLoops::configure(const ControlLoopConfig& config,
+                             ControlLoop::Feedback feedback) {
+    std::unique_ptr<ControlLoop> previous;
+    auto loop = std::make_unique<ControlLoop>(config, std::move(feedback),
+                                              motion_);
+    loop->start();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = loops_.find(config.servo);
+    if (it != loops_.end()) {
+        previous = std::move(it->second);
+    }
+    loops_[config.servo] = std::move(loop);
+    // previous is stopped and releases its channel as it goes out of scope
+}
+
+void ControlLoops::remove(int servo) {
+    std::unique_ptr<ControlLoop> loop;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = loops_.find(servo);
+        if (it == loops_.end()) {
+            return;
+        }
+        loop = std::move(it->second);
+        loops_.erase(it);
+    }
+}
+
+bool ControlLoops::set_enabled(int servo, bool enabled) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = loops_.find(servo);
+    if (it == loops_.end()) {
+        return false;
+    }
+    it->second->set_enabled(enabled);
+    return true;
+}
+
+bool ControlLoops::set_setpoint(int servo, double setpoint) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = loops_.find(servo);
+    if (it == loops_.end()) {
+        return false;
+    }
+    it->second->set_setpoint(setpoint);
+    return true;
+}
+
+std::vector<ControlLoopStatus> ControlLoops::status() {
+    std::vector<ControlLoopStatus> result;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& [servo, loop] : loops_) {
+        result.push_back(loop->status());
+    }
+    return result;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "servo_motion.hpp"
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct PidGains {
+    double kp = 0;
+    double ki = 0;
+    double kd = 0;
+    double kff = 0;           // feed-forward gain on the setpoint
+    double ff_offset = 0;     // constant feed-forward, e.g. a valve's crack point
+    // servo command units; NAN = the servo's calibrated command range
+    double output_min = NAN;
+    double output_max = NAN;
+    double tracking = 0;      // anti-windup back-calculation gain, 0 = clamp
+    double derivative_tau = 0; // derivative low-pass time constant, seconds
+};
+
+class PidController {
+    // PID on the error with feed-forward on the setpoint. The derivative acts
+    // on the measurement so setpoint steps don't kick the valve, and the
+    // integrator stops winding up while the output is saturated.
+  public:
+    struct Terms {
+        double error = 0;
+        double p = 0;
+        double i = 0;
+        double d = 0;
+        double ff = 0;
+        double output = 0;
+        bool saturated = false;
+    };
+
+    void set_gains(const PidGains& gains) { gains_ = gains; }
+    const PidGains& gains() const { return gains_; }
+    void reset(double output);
+    const Terms& update(double setpoint, double measurement, double dt);
+    const Terms& terms() const { return terms_; }
+
+  private:
+    PidGains gains_;
+    Terms terms_;
+    double integral_ = 0;
+    double derivative_ = 0;
+    double last_measurement_ = 0;
+    bool primed_ = false;
+};
+
+struct ControlLoopConfig {
+    int servo = 0;             // global servo id in the bank
+    int feedback_hat = 0;      // MCC128 address of the feedback signal
+    int feedback_channel = 0;  // analog input on that hat
+    int feedback_encoder = -1; // quadrature encoder id, used instead when >= 0
+    PidGains gains;
+    double rate_hz = 100;
+};
+
+struct ControlLoopStatus {
+    ControlLoopConfig config;
+    bool enabled = false;
+    bool feedback_ok = false;
+    double setpoint = 0;
+    double measurement = 0;
+    PidController::Terms terms;
+    double period_us = 0;     // last measured loop period
+    double max_jitter_us = 0; // worst |period - nominal| since start
+    double exec_us = 0;       // time spent in the last iteration
+    uint64_t iterations = 0;
+    uint64_t overruns = 0;
+};
+
+class ControlLoop {
+    // One closed-loop servo channel running on its own fixed-rate real-time
+    // thread: read feedback, run the PID, write the servo.
+  public:
+    using Feedback = std::function<bool(double& value)>;
+
+    ControlLoop(const ControlLoopConfig& config, Feedback feedback,
+                ServoMotion& motion);
+    ~ControlLoop();
+
+    void start();
+    void stop();
+
+    void set_enabled(bool enabled);
+    void set_setpoint(double setpoint);
+    ControlLoopStatus status();
+
+  private:
+    void run_();
+
+    ServoMotion& motion_;
+    Feedback feedback_;
+    PidController pid_;
+
+    std::mutex mutex_;       // guards status_ and pid_, never held across a bus write
+    std::mutex write_mutex_; // orders servo writes against enable/disable
+    ControlLoopStatus status_;
+    std::atomic<bool> enabled_{false};
+    std::atomic<double> setpoint_{0};
+
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+};
+
+class ControlLoops {
+    // The set of configured loops, at most one per servo channel.
+  public:
+    explicit ControlLoops(ServoMotion& motion) : motion_(motion) {}
+
+    void configure(const ControlLoopConfig& config,
+                   ControlLoop::Feedback feedback);
+    void remove(int servo);
+    bool set_enabled(int servo, bool enabled);
+    bool set_setpoint(int servo, double setpoint);
+    std::vector<ControlLoopStatus> status();
+
+  private:
+    ServoMotion& motion_;
+    std::mutex mutex_;
+    std::map<int, std::unique_ptr<ControlLoop>> loops_;
+};
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <pthread.h>
+#include <sched.h>
+
+// Moves the calling thread to SCHED_FIFO, `boost` levels above the minimum
+// priority. Best effort: returns false when the process lacks CAP_SYS_NICE.
+inline bool make_thread_realtime(int boost) {
+    sched_param param{};
+    param.sched_priority = sched_get_priority_min(SCHED_FIFO) + boost;
+    return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+}
@@ -0,0 +1,61 @@
+#include "servo_calibration.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+bool parse_servo_units(const std::string& name, ServoUnits& units) {
+    if (name == "us" || name == "microseconds") {
+        units = ServoUnits::kMicroseconds;
+    } else if (name == "angle" || name == "deg") {
+        units = ServoUnits::kAngle;
+    } else if (name == "percent") {
+        units = ServoUnits::kPercent;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void ServoCalibrationTable::build(const ServoCalibration& calibration,
+                                  uint32_t oscillator_hz, uint8_t prescale) {
+    calibration_ = calibration;
+    if (calibration_.oscillator_hz) {
+        oscillator_hz = calibration_.oscillator_hz;
+    }
+    us_per_tick_ = 1000000.0 * (prescale + 1) / oscillator_hz;
+
+    const double span = calibration_.input_max - calibration_.input_min;
+    double resolution = calibration_.resolution > 0 ? calibration_.resolution
+                                                     : 1.0;
+    // coarsen rather than allocate an unbounded table
+    resolution = std::max(resolution, std::abs(span) / (kMaxEntries - 1));
+    const size_t entries = static_cast<size_t>(std::abs(span) / resolution) + 1;
+    entries_per_unit_ = span != 0 ? (entries - 1) / span : 0;
+
+    table_.resize(entries);
+    for (size_t i = 0; i < entries; i++) {
+        double fraction = entries > 1 ? (double)i / (entries - 1) : 0.0;
+        double pulse = calibration_.pulse_at_min +
+                       fraction * (calibration_.pulse_at_max -
+                                   calibration_.pulse_at_min);
+        double ticks = std::round(pulse / us_per_tick_);
+        table_[i] = (uint16_t)std::clamp(ticks, 0.0, 4095.0);
+    }
+}
+
+double ServoCalibrationTable::clamp(double command) const {
+    return std::clamp(command,
+                      std::min(calibration_.input_min, calibration_.input_max),
+                      std::max(calibration_.input_min, calibration_.input_max));
+}
+
+double ServoCalibrationTable::command_for_ticks(uint16_t ticks) const {
+    double pulse_span = calibration_.pulse_at_max - calibration_.pulse_at_min;
+    if (pulse_span == 0 || us_per_tick_ == 0) {
+        return calibration_.input_min;
+    }
+    double fraction = (ticks * us_per_tick_ - calibration_.pulse_at_min) /
+                      pulse_span;
+    return clamp(calibration_.input_min +
+                 fraction * (calibration_.input_max - calibration_.input_min));
+}
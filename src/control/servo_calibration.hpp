@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class ServoUnits { kMicroseconds, kAngle, kPercent };
+
+bool parse_servo_units(const std::string& name, ServoUnits& units);
+
+struct ServoCalibration {
+    // Commands arrive in these units over [input_min, input_max] and map
+    // linearly onto the measured pulse widths at either end of travel.
+    ServoUnits units = ServoUnits::kMicroseconds;
+    double input_min = 500.0;
+    double input_max = 2500.0;
+    double pulse_at_min = 500.0;  // us
+    double pulse_at_max = 2500.0; // us
+    double resolution = 1.0;      // command units per table entry
+    uint32_t oscillator_hz = 0;   // measured PCA9685 clock, 0 = board value
+};
+
+class ServoCalibrationTable {
+    // ServoCalibration compiled into PCA9685 tick values, one entry per
+    // resolution step of the command range, so converting a command is a
+    // clamp and an index instead of floating-point pulse math.
+  public:
+    static constexpr size_t kMaxEntries = 1 << 16;
+
+    void build(const ServoCalibration& calibration, uint32_t oscillator_hz,
+               uint8_t prescale);
+
+    uint16_t ticks(double command) const {
+        if (table_.empty()) {
+            return 0;
+        }
+        double index = (command - calibration_.input_min) * entries_per_unit_;
+        if (index <= 0) {
+            return table_.front();
+        }
+        if (index >= table_.size() - 1) {
+            return table_.back();
+        }
+        return table_[static_cast<size_t>(index + 0.5)];
+    }
+
+    double clamp(double command) const;
+    double command_for_ticks(uint16_t ticks) const;
+    const ServoCalibration& calibration() const { return calibration_; }
+
+  private:
+    ServoCalibration calibration_;
+    double entries_per_unit_ = 0;
+    double us_per_tick_ = 0;
+    std::vector<uint16_t> table_;
+};
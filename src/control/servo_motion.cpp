@@ -0,0 +1,335 @@
+#include "servo_motion.hpp"
+#include "realtime.hpp"
+#include "../logging/log.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+bool parse_motion_profile(const std::string& name, MotionProfile& profile) {
+    if (name == "step") {
+        profile = MotionProfile::kStep;
+    } else if (name == "trapezoid") {
+        profile = MotionProfile::kTrapezoid;
+    } else if (name == "scurve") {
+        profile = MotionProfile::kSCurve;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void ServoTrajectory::reset(double position) {
+    position_ = target_ = position;
+    velocity_ = accel_ = 0;
+}
+
+double ServoTrajectory::step(double dt) {
+    const double a = limits_.max_accel;
+    const bool scurve =
+        limits_.profile == MotionProfile::kSCurve && limits_.max_jerk > 0;
+
+    if (limits_.profile == MotionProfile::kStep || limits_.max_rate <= 0 ||
+        a <= 0 || dt <= 0) {
+        position_ = target_;
+        velocity_ = accel_ = 0;
+        return position_;
+    }
+    if (settled()) {
+        return position_;
+    }
+
+    const double distance = target_ - position_;
+    const double dir = distance >= 0 ? 1.0 : -1.0;
+    const double remaining = std::abs(distance);
+
+    // Fastest speed from which we can still stop exactly at the target
+    double stop_speed;
+    if (scurve) {
+        // braking distance with the deceleration ramped in at max_jerk is
+        // d = v^2 / 2a + v a / 2j, solved for v
+        const double ramp = a / (2 * limits_.max_jerk);
+        stop_speed = a * (std::sqrt(ramp * ramp + 2 * remaining / a) - ramp);
+    } else {
+        // discrete form of sqrt(2 a d): braking by a*dt per tick covers
+        // a dt^2 k(k+1)/2 from speed k a dt
+        const double brake = a * dt;
+        stop_speed =
+            brake * (std::sqrt(0.25 + 2 * remaining / (brake * dt)) - 0.5);
+    }
+    const double desired = dir * std::min(limits_.max_rate, stop_speed);
+
+    if (scurve) {
+        // close the velocity error over one acceleration ramp, slewing the
+        // acceleration itself at no more than max_jerk
+        const double ramp_time = std::max(a / limits_.max_jerk, dt);
+        const double wanted =
+            std::clamp((desired - velocity_) / ramp_time, -a, a);
+        const double max_change = limits_.max_jerk * dt;
+        accel_ += std::clamp(wanted - accel_, -max_change, max_change);
+    } else {
+        accel_ = std::clamp((desired - velocity_) / dt, -a, a);
+    }
+    velocity_ += accel_ * dt;
+    position_ += velocity_ * dt;
+
+    // Land on the target once we reach or step across it at creep speed
+    const double left = target_ - position_;
+    if (left * dir <= 0 && std::abs(velocity_) <= 2 * a * dt) {
+        position_ = target_;
+        velocity_ = accel_ = 0;
+    }
+    return position_;
+}
+
+ServoMotion::ServoMotion(ServoBank& bank)
+    : bank_(bank), channels_(bank.size()) {
+    updates_.reserve(channels_.size());
+    for (size_t id = 0; id < channels_.size(); id++) {
+        build_table_(id, ServoCalibration{});
+    }
+}
+
+ServoMotion::~ServoMotion() { stop(); }
+
+void ServoMotion::build_table_(int id, const ServoCalibration& calibration) {
+    ServoMapping m;
+    if (!bank_.lookup(id, m)) {
+        return;
+    }
+    PwmDriver& board = bank_.board(m.board);
+    channels_[id].table.build(calibration, board.getOscillatorFrequency(),
+                              board.readPrescale());
+}
+
+void ServoMotion::start() {
+    if (running_.exchange(true)) {
+        return;
+    }
+    thread_ = std::thread(&ServoMotion::run_, this);
+}
+
+void ServoMotion::stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void ServoMotion::set_observer(Observer observer) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    observer_ = std::move(observer);
+}
+
+bool ServoMotion::set_limits(int id, const MotionLimits& limits) {
+    if (id < 0 || (size_t)id >= channels_.size()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    channels_[id].trajectory.set_limits(limits);
+    return true;
+}
+
+bool ServoMotion::set_calibration(int id, const ServoCalibration& calibration) {
+    if (id < 0 || (size_t)id >= channels_.size()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    build_table_(id, calibration);
+    // units may have changed, restart from the output's current position
+    channels_[id].active = false;
+    return true;
+}
+
+ServoCalibration ServoMotion::calibration(int id) {
+    if (id < 0 || (size_t)id >= channels_.size()) {
+        return ServoCalibration{};
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    return channels_[id].table.calibration();
+}
+
+bool ServoMotion::set_target(int id, double command) {
+    // ids on a board that didn't come up are refused, not silently dropped
+    if (id < 0 || (size_t)id >= channels_.size() || !bank_.available(id)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    Channel& channel = channels_[id];
+    command = channel.table.clamp(command);
+
+    if (!channel.active) {
+        // First command on this servo: ramp from wherever the output is
+        // now, or jump if it has never been driven
+        uint16_t ticks = bank_.get_ticks(id);
+        bool driven = ticks > 0 && ticks < 4096;
+        channel.trajectory.reset(
+            driven ? channel.table.command_for_ticks(ticks) : command);
+        channel.ticks = driven ? ticks : 0;
+        channel.active = true;
+    }
+    channel.trajectory.set_target(command);
+    return true;
+}
+
+bool ServoMotion::write_direct(int id, double command) {
+    if (id < 0 || (size_t)id >= channels_.size() || !bank_.available(id)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    Channel& channel = channels_[id];
+    channel.held = true;
+    uint16_t ticks = channel.table.ticks(command);
+    if (ticks != channel.ticks) {
+        channel.ticks = ticks;
+        ServoBank::Update update{id, ticks};
+        bank_.write(&update, 1);
+        if (observer_) {
+            outputs_.assign(1, {id, ticks, channel.table.clamp(command)});
+            observer_(outputs_);
+        }
+    }
+    return true;
+}
+
+void ServoMotion::release(int id) {
+    if (id < 0 || (size_t)id >= channels_.size()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    channels_[id].held = false;
+    // next set_target ramps from wherever the loop left the output
+    channels_[id].active = false;
+}
+
+double ServoMotion::position(int id) {
+    if (id < 0 || (size_t)id >= channels_.size()) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (channels_[id].active) {
+        return channels_[id].trajectory.position();
+    }
+    return channels_[id].table.command_for_ticks(bank_.get_ticks(id));
+}
+
+bool ServoMotion::resync() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    struct Clock {
+        uint8_t prescale;
+        uint32_t oscillator_hz;
+    };
+    std::vector<Clock> before(bank_.board_count());
+    for (size_t b = 0; b < before.size(); b++) {
+        before[b] = {bank_.board(b).readPrescale(), bank_.board(b).getOscillatorFrequency()};
+    }
+    bool in_sync = bank_.resync();
+
+    std::vector<bool> changed(before.size());
+    for (size_t b = 0; b < before.size(); b++) {
+        PwmDriver& board = bank_.board(b);
+        changed[b] = board.readPrescale() != before[b].prescale ||
+                     board.getOscillatorFrequency() != before[b].oscillator_hz;
+        if (changed[b]) {
+            logging::warn(logging::Module::kServo, "Servo board {} prescale went from {} to {}, rebuilding its tables",
+                          b, before[b].prescale, board.readPrescale());
+            retime_ = true;
+        }
+    }
+    for (size_t id = 0; id < channels_.size(); id++) {
+        ServoMapping m;
+        if (!bank_.lookup(id, m)) {
+            continue;
+        }
+        Channel& channel = channels_[id];
+        if (changed[m.board]) {
+            build_table_(id, channel.table.calibration());
+        }
+        // compare the next output against what the chip holds now
+        channel.ticks = bank_.get_ticks(id);
+    }
+    return in_sync;
+}
+
+void ServoMotion::tick_(const std::vector<double>& board_dt) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    updates_.clear();
+    outputs_.clear();
+    for (size_t id = 0; id < channels_.size(); id++) {
+        Channel& channel = channels_[id];
+        ServoMapping m;
+        if (!channel.active || channel.held || !bank_.lookup(id, m) ||
+            board_dt[m.board] <= 0) {
+            continue;
+        }
+        double dt = board_dt[m.board];
+        uint16_t ticks = channel.table.ticks(channel.trajectory.step(dt));
+        if (ticks != channel.ticks) {
+            channel.ticks = ticks;
+            updates_.push_back({(int)id, ticks});
+            outputs_.push_back({(int)id, ticks, channel.trajectory.position()});
+        }
+    }
+    if (!updates_.empty()) {
+        bank_.write(updates_.data(), updates_.size());
+        if (observer_) {
+            observer_(outputs_);
+        }
+    }
+}
+
+void ServoMotion::run_() {
+    using clock = std::chrono::steady_clock;
+
+    // Best effort: run ahead of the sampling and MQTT threads when allowed
+    if (!make_thread_realtime(10)) {
+        logging::warn(logging::Module::kServo,
+                      "Servo motion thread running without real-time priority");
+    }
+
+    // boards can run different prescales, so each keeps its own frame clock;
+    // boards whose frames fall due together are stepped in the same pass
+    const size_t boards = bank_.board_count();
+    if (boards == 0) {
+        return;
+    }
+    std::vector<clock::duration> period(boards);
+    std::vector<clock::time_point> next(boards, clock::now());
+    std::vector<double> frame_dt(boards);
+    std::vector<double> due(boards);
+    retime_ = true;
+
+    while (running_) {
+        if (retime_.exchange(false)) {
+            // first pass, or resync() found a board on a new prescale; the
+            // frame in progress ends one new period after it started
+            for (size_t b = 0; b < boards; b++) {
+                next[b] -= period[b];
+                period[b] = std::chrono::duration_cast<clock::duration>(
+                    std::chrono::duration<double>(1.0 / bank_.board(b).getPWMFreq()));
+                next[b] += period[b];
+                frame_dt[b] = std::chrono::duration<double>(period[b]).count();
+            }
+        }
+        std::this_thread::sleep_until(*std::min_element(next.begin(), next.end()));
+
+        auto now = clock::now();
+        for (size_t b = 0; b < boards; b++) {
+            due[b] = next[b] <= now ? frame_dt[b] : 0;
+        }
+        tick_(due);
+
+        now = clock::now();
+        for (size_t b = 0; b < boards; b++) {
+            if (due[b] <= 0) {
+                continue;
+            }
+            next[b] += period[b];
+            if (next[b] < now) {
+                // overran one or more frames, skip them instead of bursting
+                next[b] += period[b] * ((now - next[b]) / period[b] + 1);
+            }
+        }
+    }
+}
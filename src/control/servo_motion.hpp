@@ -0,0 +1,125 @@
+#pragma once
+
+#include "../interfaces/servo_bank.hpp"
+#include "servo_calibration.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class MotionProfile {
+    kStep,      // jump straight to the target, the old writeMicroseconds path
+    kTrapezoid, // rate and acceleration limited
+    kSCurve     // rate, acceleration and jerk limited
+};
+
+bool parse_motion_profile(const std::string& name, MotionProfile& profile);
+
+struct MotionLimits {
+    // In the channel's calibrated command units (us, degrees or percent)
+    MotionProfile profile = MotionProfile::kTrapezoid;
+    double max_rate = 2000.0;   // units per second
+    double max_accel = 10000.0; // units per second^2
+    double max_jerk = 100000.0; // units per second^3, S-curve only
+};
+
+class ServoTrajectory {
+    // Online trajectory generator for one servo channel. The target can move
+    // at any time; each step() brakes or accelerates toward it so the
+    // position never exceeds the rate, acceleration and jerk limits.
+  public:
+    void set_limits(const MotionLimits& limits) { limits_ = limits; }
+    const MotionLimits& limits() const { return limits_; }
+
+    void set_target(double target) { target_ = target; }
+    void reset(double position);
+    double step(double dt);
+
+    double position() const { return position_; }
+    double target() const { return target_; }
+    bool settled() const { return position_ == target_ && velocity_ == 0; }
+
+  private:
+    MotionLimits limits_;
+    double position_ = 0;
+    double velocity_ = 0;
+    double accel_ = 0;
+    double target_ = 0;
+};
+
+class ServoMotion {
+    // Runs one ServoTrajectory per servo in the bank on a fixed-rate thread
+    // locked to each board's PWM frame (20 ms at 50 Hz). Every servo that
+    // moved during a tick is handed to ServoBank::write together, so each
+    // board gets a single block transfer per frame.
+    // Targets are in each servo's calibrated units and are turned into
+    // ticks through that servo's ServoCalibrationTable.
+  public:
+    // A servo's new output, reported after it has been written to the bank
+    struct Output {
+        int id;
+        uint16_t ticks;
+        double position; // calibrated units
+    };
+    // Called with the motion lock held, keep it short and don't call back in
+    using Observer = std::function<void(const std::vector<Output>& outputs)>;
+
+    explicit ServoMotion(ServoBank& bank);
+    ~ServoMotion();
+
+    void start();
+    void stop();
+    void set_observer(Observer observer);
+
+    bool set_limits(int id, const MotionLimits& limits);
+    bool set_calibration(int id, const ServoCalibration& calibration);
+    // The servo's current calibration, the default for an unknown id
+    ServoCalibration calibration(int id);
+    // set_target() and write_direct() return false for an unknown id or one
+    // on a board that failed to initialize
+    bool set_target(int id, double command);
+
+    // Closed-loop control: write a command straight to the output, bypassing
+    // the trajectory, and keep the motion thread off the servo until it is
+    // released again.
+    bool write_direct(int id, double command);
+    void release(int id);
+    double position(int id);
+
+    // Reloads the bank's register shadows from the chips (ServoBank::resync)
+    // with the motion thread held off. A board that came back with another
+    // prescale or oscillator, as one does after a brown-out, gets its tick
+    // tables rebuilt and its frame clock retimed; every servo then rewrites
+    // whatever the chip lost on the next frame. False if a shadow had drifted.
+    bool resync();
+
+  private:
+    struct Channel {
+        ServoTrajectory trajectory;
+        ServoCalibrationTable table;
+        uint16_t ticks = 0;
+        bool active = false; // set once the servo has been commanded
+        bool held = false;   // set while the servo is under write_direct
+    };
+
+    void run_();
+    // Steps the servos of every board with a nonzero entry by that dt
+    void tick_(const std::vector<double>& board_dt);
+    void build_table_(int id, const ServoCalibration& calibration);
+
+    ServoBank& bank_;
+    std::vector<Channel> channels_;
+    std::vector<ServoBank::Update> updates_; // reused by tick_
+    std::vector<Output> outputs_;            // likewise
+    Observer observer_;
+    std::mutex mutex_;
+
+    std::atomic<bool> running_{false};
+    std::atomic<bool> retime_{false}; // a board's frame rate changed
+    std::thread thread_;
+};
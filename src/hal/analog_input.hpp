@@ -0,0 +1,16 @@
+#pragma once
+
+#include <vector>
+
+class AnalogInput {
+    // Single-ended analog inputs on one or more boards (MCC128 hats on the
+    // Pi, SimAnalogInput elsewhere), read one sample at a time.
+  public:
+    virtual ~AnalogInput() = default;
+
+    // Finds and opens every board, returns their addresses
+    virtual std::vector<int> open() = 0;
+    virtual void close() = 0;
+    // Volts; false if the read failed and value is not valid
+    virtual bool read(int board, int channel, double& value) = 0;
+};
@@ -0,0 +1,62 @@
+#include "hal.hpp"
+#include "sim_analog_input.hpp"
+#include "sim_gpio_backend.hpp"
+#include "sim_pwm_driver.hpp"
+#include "sim_relay_expander.hpp"
+#include "../interfaces/io_expander.hpp"
+
+#ifdef HAVE_DAQHATS
+#include "mcc128_input.hpp"
+#endif
+#ifdef HAVE_WIRINGPI
+#include "../interfaces/servo.hpp"
+#endif
+
+#include <stdexcept>
+
+bool hal_is_sim(const HalSettings& hal) {
+    return hal.backend == "sim";
+}
+
+std::unique_ptr<AnalogInput> make_analog_input(const HalSettings& hal) {
+    if (hal_is_sim(hal)) {
+        return std::make_unique<SimAnalogInput>(hal.sim);
+    }
+#ifdef HAVE_DAQHATS
+    return std::make_unique<MCC128Input>();
+#else
+    throw std::runtime_error("built without daqhats, use hal backend \"sim\"");
+#endif
+}
+
+std::unique_ptr<RelayExpander> make_relay_expander(const HalSettings& hal, const std::string& bus,
+                                                   uint8_t address) {
+    if (hal_is_sim(hal)) {
+        return std::make_unique<SimRelayExpander>(hal.sim);
+    }
+    return std::make_unique<TCA9535>(bus.c_str(), address);
+}
+
+std::unique_ptr<PwmDriver> make_pwm_driver(const HalSettings& hal, uint8_t address) {
+    if (hal_is_sim(hal)) {
+        return std::make_unique<SimPwmDriver>(hal.sim, address);
+    }
+#ifdef HAVE_WIRINGPI
+    return std::make_unique<Adafruit_PWMServoDriver>(address);
+#else
+    throw std::runtime_error("built without wiringPi, use hal backend \"sim\"");
+#endif
+}
+
+std::unique_ptr<GPIO_Backend> make_gpio(const HalSettings& hal, const std::string& chip) {
+    if (hal_is_sim(hal)) {
+        return std::make_unique<SimGpioBackend>(hal.sim);
+    }
+    return make_gpio_backend(chip);
+}
+
+#ifndef HAVE_LIBGPIOD
+std::unique_ptr<GPIO_Backend> make_gpio_backend(const std::string&) {
+    throw std::runtime_error("built without libgpiod, use hal backend \"sim\"");
+}
+#endif
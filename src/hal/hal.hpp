@@ -0,0 +1,24 @@
+#pragma once
+
+#include "analog_input.hpp"
+#include "pwm_driver.hpp"
+#include "relay_expander.hpp"
+#include "sim_settings.hpp"
+#include "../interfaces/gpio_backend.hpp"
+
+#include <memory>
+#include <string>
+
+// Device factories. With backend "hardware" these return the real drivers
+// (MCC128 via daqhats, PCA9685 via wiringPi, TCA9535 via i2c-dev, libgpiod)
+// and throw std::runtime_error if the program was built without the library
+// one of them needs. With backend "sim" they return the simulators, so the
+// whole pipeline runs on any Linux machine.
+
+bool hal_is_sim(const HalSettings& hal);
+
+std::unique_ptr<AnalogInput> make_analog_input(const HalSettings& hal);
+std::unique_ptr<RelayExpander> make_relay_expander(const HalSettings& hal,
+                                                   const std::string& bus, uint8_t address);
+std::unique_ptr<PwmDriver> make_pwm_driver(const HalSettings& hal, uint8_t address);
+std::unique_ptr<GPIO_Backend> make_gpio(const HalSettings& hal, const std::string& chip);
@@ -0,0 +1,40 @@
+#include "mcc128_input.hpp"
+#include "../logging/log.hpp"
+
+#include <daqhats/daqhats.h>
+#include <daqhats/mcc128.h>
+
+#include <stdexcept>
+
+std::vector<int> MCC128Input::open() {
+    close();
+    int count = hat_list(HAT_ID_MCC_128, NULL);
+    if (count < 0) {
+        throw std::runtime_error("Error listing DAQ hats");
+    }
+
+    std::vector<HatInfo> list(count);
+    if (count > 0) {
+        hat_list(HAT_ID_MCC_128, list.data());
+    }
+    for (const auto& info : list) {
+        if (mcc128_open(info.address) != RESULT_SUCCESS) {
+            logging::error(logging::Module::kDaq, "Failed to open DAQ Hat at address: {}", info.address);
+            continue;
+        }
+        boards_.push_back(info.address);
+        logging::info(logging::Module::kDaq, "Detected DAQ Hat at address: {}", info.address);
+    }
+    return boards_;
+}
+
+void MCC128Input::close() {
+    for (int board : boards_) {
+        mcc128_close(board);
+    }
+    boards_.clear();
+}
+
+bool MCC128Input::read(int board, int channel, double& value) {
+    return mcc128_a_in_read(board, channel, OPTS_DEFAULT, &value) == RESULT_SUCCESS;
+}
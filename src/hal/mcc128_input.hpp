@@ -0,0 +1,17 @@
+#pragma once
+
+#include "analog_input.hpp"
+
+class MCC128Input : public AnalogInput {
+    // Every MCC128 hat on the Pi, read with software-paced single samples
+    // through daqhats. Only built when daqhats is available.
+  public:
+    ~MCC128Input() override { close(); }
+
+    std::vector<int> open() override;
+    void close() override;
+    bool read(int board, int channel, double& value) override;
+
+  private:
+    std::vector<int> boards_;
+};
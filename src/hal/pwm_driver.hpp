@@ -0,0 +1,36 @@
+#pragma once
+
+#include "../interfaces/pca9685_regs.hpp"
+
+#include <cstdint>
+
+/*!
+ *  @brief  A PCA9685-style 16 channel, 12 bit PWM generator. Implemented by
+ *  Adafruit_PWMServoDriver for the real chip and SimPwmDriver for testing
+ *  off the Pi. Method names follow the Adafruit driver.
+ */
+class PwmDriver {
+  public:
+    virtual ~PwmDriver() = default;
+
+    virtual bool begin(uint8_t prescale = 0) = 0;
+    virtual void reset() = 0;
+    virtual void setPWMFreq(float freq) = 0;
+    virtual float getPWMFreq() = 0;
+    virtual uint8_t readPrescale() = 0;
+    virtual void setOscillatorFrequency(uint32_t freq) = 0;
+    virtual uint32_t getOscillatorFrequency() = 0;
+
+    virtual uint16_t getPWM(uint8_t num) = 0;
+    virtual void setPWM(uint8_t num, uint16_t on, uint16_t off) = 0;
+    virtual void setMultiplePWM(uint8_t first, uint8_t count, const uint16_t* on,
+                                const uint16_t* off) = 0;
+    virtual void setPWMChannels(uint16_t mask, const uint16_t* on,
+                                const uint16_t* off) = 0;
+    virtual void setAllPWM(uint16_t on, uint16_t off) = 0;
+    virtual void writeMicroseconds(uint8_t num, uint16_t Microseconds) = 0;
+
+    // Reloads the driver's view of the registers from the chip, false if
+    // they had drifted apart
+    virtual bool resync() = 0;
+};
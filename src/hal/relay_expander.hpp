@@ -0,0 +1,16 @@
+#pragma once
+
+#include <bitset>
+#include <cstdint>
+
+class RelayExpander {
+    // 16 bit I/O expander driving the relay board (TCA9535 on the Pi,
+    // SimRelayExpander elsewhere). Writes throw std::runtime_error once
+    // retries are exhausted.
+  public:
+    virtual ~RelayExpander() = default;
+
+    virtual void configure_port(uint8_t port, uint8_t direction) = 0;
+    virtual void write_output(std::bitset<16> state) = 0;
+    virtual uint8_t read_input(uint8_t port) = 0;
+};
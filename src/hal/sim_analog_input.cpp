@@ -0,0 +1,55 @@
+#include "sim_analog_input.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr int kChannels = 8;
+constexpr double kRange = 10.0; // MCC128 +/-10 V
+}
+
+SimAnalogInput::SimAnalogInput(const SimSettings& settings)
+    : settings_(settings), faults_(settings.daq), start_(std::chrono::steady_clock::now()) {}
+
+std::vector<int> SimAnalogInput::open() {
+    start_ = std::chrono::steady_clock::now();
+    return settings_.hats;
+}
+
+const SimWaveform& SimAnalogInput::waveform_(int channel) const {
+    auto it = settings_.channels.find(channel);
+    return it != settings_.channels.end() ? it->second : settings_.waveform;
+}
+
+bool SimAnalogInput::read(int board, int channel, double& value) {
+    if (channel < 0 || channel >= kChannels ||
+        std::find(settings_.hats.begin(), settings_.hats.end(), board) == settings_.hats.end()) {
+        return false;
+    }
+    if (!faults_.access()) {
+        return false;
+    }
+
+    const SimWaveform& w = waveform_(channel);
+    double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+    double phase = std::fmod(t * w.frequency_hz + channel / 8.0, 1.0); // 0..1
+    double shape;
+    if (w.shape == "square") {
+        shape = phase < 0.5 ? 1.0 : -1.0;
+    } else if (w.shape == "triangle") {
+        shape = phase < 0.5 ? 4 * phase - 1 : 3 - 4 * phase;
+    } else if (w.shape == "sawtooth") {
+        shape = 2 * phase - 1;
+    } else if (w.shape == "constant") {
+        shape = 0;
+    } else {
+        shape = std::sin(2 * M_PI * phase);
+    }
+
+    value = w.offset + w.amplitude * shape;
+    if (w.noise > 0) {
+        value += std::normal_distribution<double>(0, w.noise)(FaultInjector::rng());
+    }
+    value = std::clamp(value, -kRange, kRange);
+    return true;
+}
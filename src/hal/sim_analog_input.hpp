@@ -0,0 +1,25 @@
+#pragma once
+
+#include "analog_input.hpp"
+#include "sim_faults.hpp"
+
+#include <chrono>
+
+class SimAnalogInput : public AnalogInput {
+    // Eight channels per simulated hat, each producing its waveform as a
+    // function of time since open(), with optional gaussian noise. Channels
+    // are phase-shifted by 45 degrees so they are distinguishable.
+  public:
+    explicit SimAnalogInput(const SimSettings& settings);
+
+    std::vector<int> open() override;
+    void close() override {}
+    bool read(int board, int channel, double& value) override;
+
+  private:
+    const SimWaveform& waveform_(int channel) const;
+
+    SimSettings settings_;
+    FaultInjector faults_;
+    std::chrono::steady_clock::time_point start_;
+};
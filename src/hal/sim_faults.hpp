@@ -0,0 +1,47 @@
+#pragma once
+
+#include "sim_settings.hpp"
+
+#include <chrono>
+#include <random>
+#include <thread>
+
+class FaultInjector {
+    // Latency and failures for one simulated device. Thread-safe: the random
+    // state is per thread.
+  public:
+    explicit FaultInjector(const SimFaults& faults) : faults_(faults) {}
+
+    // Waits out the access time (configured latency, jitter and extra_ns of
+    // transfer time), then returns false if this access is to fail
+    bool access(uint64_t extra_ns = 0) const {
+        uint64_t ns = extra_ns + uint64_t(faults_.latency_us) * 1000;
+        if (faults_.jitter_us) {
+            ns += std::uniform_int_distribution<uint64_t>(0, uint64_t(faults_.jitter_us) * 1000)(rng());
+        }
+        wait_(ns);
+        return faults_.fault_rate <= 0 ||
+               std::uniform_real_distribution<double>(0, 1)(rng()) >= faults_.fault_rate;
+    }
+
+    static std::minstd_rand& rng() {
+        thread_local std::minstd_rand engine{std::random_device{}()};
+        return engine;
+    }
+
+  private:
+    // the scheduler can't sleep less than ~60 us, spin for short waits so
+    // the simulated rates stay realistic
+    static void wait_(uint64_t ns) {
+        if (!ns) return;
+        auto until = std::chrono::steady_clock::now() + std::chrono::nanoseconds(ns);
+        if (ns > 200000) {
+            std::this_thread::sleep_until(until);
+            return;
+        }
+        while (std::chrono::steady_clock::now() < until) {
+        }
+    }
+
+    SimFaults faults_;
+};
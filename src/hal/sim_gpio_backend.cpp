@@ -0,0 +1,186 @@
+#include "sim_gpio_backend.hpp"
+#include "../logging/log.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace {
+// same depth as the kernel's per-request event buffer; older edges are lost
+constexpr size_t kQueueDepth = 1024;
+
+uint64_t now_ns(GPIO_EventClock clock) {
+    timespec ts;
+    clock_gettime(clock == GPIO_EventClock::kRealtime ? CLOCK_REALTIME : CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+}
+
+SimGpioBackend::SimGpioBackend(const SimSettings& settings)
+    : waves_(settings.gpio_inputs), loopback_(settings.gpio_loopback), faults_(settings.gpio), start_(std::chrono::steady_clock::now()) {
+    event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (event_fd_ < 0) {
+        throw std::runtime_error("Failed to create GPIO event fd");
+    }
+    thread_ = std::thread(&SimGpioBackend::generate_, this);
+    logging::info(logging::Module::kGpio, "Simulated GPIO chip with {} generated inputs", waves_.size());
+}
+
+SimGpioBackend::~SimGpioBackend() {
+    stop_ = true;
+    wake_.notify_all();
+    thread_.join();
+    close(event_fd_);
+}
+
+bool SimGpioBackend::request_outputs(const std::vector<GPIO_LineConfig>& lines) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    outputs_ = lines;
+    output_levels_.clear();
+    for (const auto& line : lines) {
+        output_levels_.push_back(line.value);
+    }
+    return true;
+}
+
+bool SimGpioBackend::request_inputs(const std::vector<GPIO_LineConfig>& lines, GPIO_EventClock clock) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+    inputs_.clear();
+    for (const auto& line : lines) {
+        Input input;
+        input.line = line;
+        auto it = waves_.find(line.pin);
+        if (it != waves_.end()) {
+            input.wave = it->second;
+            input.level = std::fmod(level_time_(input.wave, t), 1.0) < 0.5;
+        }
+        inputs_.push_back(input);
+    }
+    clock_ = clock;
+    queue_.clear();
+    wake_.notify_all();
+    return true;
+}
+
+void SimGpioBackend::release_outputs() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    outputs_.clear();
+    output_levels_.clear();
+}
+
+void SimGpioBackend::release_inputs() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    inputs_.clear();
+    queue_.clear();
+}
+
+bool SimGpioBackend::set_outputs(const int* levels) {
+    if (!faults_.access()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    bool emitted = false;
+    for (size_t i = 0; i < outputs_.size(); i++) {
+        auto wire = loopback_.find(outputs_[i].pin);
+        if (wire == loopback_.end() || levels[i] == output_levels_[i]) continue;
+        for (auto& input : inputs_) {
+            if (input.line.pin == wire->second) {
+                emitted |= edge_(input, levels[i] != 0, now_ns(clock_));
+            }
+        }
+    }
+    output_levels_.assign(levels, levels + outputs_.size());
+    if (emitted) {
+        uint64_t one = 1;
+        (void)write(event_fd_, &one, sizeof(one));
+    }
+    return true;
+}
+
+bool SimGpioBackend::get_inputs(int* levels) {
+    if (!faults_.access()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < inputs_.size(); i++) {
+        levels[i] = inputs_[i].level;
+    }
+    return true;
+}
+
+std::vector<int> SimGpioBackend::event_fds() {
+    return {event_fd_};
+}
+
+int SimGpioBackend::read_events(int fd, GPIO_Event* events, int max_events) {
+    if (fd != event_fd_) {
+        return -1;
+    }
+    uint64_t pending;
+    (void)read(event_fd_, &pending, sizeof(pending));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    int n = 0;
+    while (n < max_events && !queue_.empty()) {
+        events[n++] = queue_.front();
+        queue_.pop_front();
+    }
+    if (!queue_.empty()) {
+        uint64_t one = 1; // more to read, stay readable
+        (void)write(event_fd_, &one, sizeof(one));
+    }
+    return n;
+}
+
+// Position in the wave in cycles; the line is high for the first half of
+// each cycle
+double SimGpioBackend::level_time_(const SimGpioInput& wave, double t) {
+    double cycles = t * wave.frequency_hz - wave.phase_deg / 360.0;
+    return cycles - std::floor(cycles);
+}
+
+// Queues an edge if the level changed and the debounce period has passed
+bool SimGpioBackend::edge_(Input& input, int level, uint64_t ts) {
+    if (level == input.level) {
+        return false;
+    }
+    input.level = level;
+    if (ts - input.last_edge_ns < uint64_t(input.line.debounce_us) * 1000) {
+        return false;
+    }
+    input.last_edge_ns = ts;
+    if (queue_.size() == kQueueDepth) queue_.pop_front();
+    queue_.push_back({input.line.pin, level, ts});
+    return true;
+}
+
+void SimGpioBackend::generate_() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_) {
+        double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+
+        // emit every edge that is due, then sleep until the next one
+        double next = t + 0.1;
+        bool emitted = false;
+        for (auto& input : inputs_) {
+            if (input.wave.frequency_hz <= 0) continue;
+            emitted |= edge_(input, level_time_(input.wave, t) < 0.5, now_ns(clock_));
+            double half = 0.5 / input.wave.frequency_hz;
+            double into = level_time_(input.wave, t) / input.wave.frequency_hz;
+            double to_edge = (into < half ? half : 2 * half) - into;
+            next = std::min(next, t + to_edge + 1e-7);
+        }
+        if (emitted) {
+            uint64_t one = 1;
+            (void)write(event_fd_, &one, sizeof(one));
+        }
+
+        auto until = start_ + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                  std::chrono::duration<double>(next));
+        wake_.wait_until(lock, until);
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "sim_faults.hpp"
+#include "../interfaces/gpio_backend.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+
+class SimGpioBackend : public GPIO_Backend {
+    // Software GPIO chip. Outputs just latch. Inputs listed in the sim
+    // settings toggle as square waves at their frequency and phase (a 90
+    // degree pair looks like a quadrature encoder); the others hold low.
+    // An output wired to an input in gpio_loopback drives it directly.
+    // Edges are generated on a thread, debounced like the kernel would, and
+    // queued behind an eventfd so GPIO_Manager and QuadratureEncoder can
+    // epoll them exactly as they do a real chip.
+  public:
+    explicit SimGpioBackend(const SimSettings& settings);
+    ~SimGpioBackend() override;
+
+    bool request_outputs(const std::vector<GPIO_LineConfig>& lines) override;
+    bool request_inputs(const std::vector<GPIO_LineConfig>& lines,
+                        GPIO_EventClock clock) override;
+    void release_outputs() override;
+    void release_inputs() override;
+
+    bool set_outputs(const int* levels) override;
+    bool get_inputs(int* levels) override;
+
+    std::vector<int> event_fds() override;
+    int read_events(int fd, GPIO_Event* events, int max_events) override;
+
+    bool supports_debounce() const override { return true; }
+
+  private:
+    struct Input {
+        GPIO_LineConfig line;
+        SimGpioInput wave;
+        int level = 0;
+        uint64_t last_edge_ns = 0;
+    };
+
+    void generate_();
+    // mutex_ held
+    bool edge_(Input& input, int level, uint64_t ts);
+    static double level_time_(const SimGpioInput& wave, double t);
+
+    std::map<int, SimGpioInput> waves_;
+    std::map<int, int> loopback_;
+    FaultInjector faults_;
+    int event_fd_ = -1;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::vector<GPIO_LineConfig> outputs_;
+    std::vector<int> output_levels_;
+    std::vector<Input> inputs_;
+    GPIO_EventClock clock_ = GPIO_EventClock::kMonotonic;
+    std::deque<GPIO_Event> queue_;
+    std::chrono::steady_clock::time_point start_;
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+};
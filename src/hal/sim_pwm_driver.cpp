@@ -0,0 +1,197 @@
+#include "sim_pwm_driver.hpp"
+#include "../logging/log.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+constexpr size_t kLedBytes = PCA9685_CHANNELS * PCA9685_CHANNEL_REGS;
+}
+
+SimPwmDriver::SimPwmDriver(const SimSettings& settings, uint8_t addr)
+    : faults_(settings.i2c), addr_(addr),
+      byte_ns_(settings.i2c_hz ? 9 * 1000000000ull / settings.i2c_hz : 0) {
+    power_on_(chip_);
+    std::memcpy(regs_, chip_, sizeof(regs_));
+}
+
+// power-on defaults, same as the real driver
+void SimPwmDriver::power_on_(uint8_t* regs) {
+    std::memset(regs, 0, 256);
+    regs[PCA9685_MODE1] = MODE1_SLEEP | MODE1_ALLCAL;
+    regs[PCA9685_MODE2] = MODE2_OUTDRV;
+    regs[PCA9685_PRESCALE] = 0x1E;
+    for (uint8_t i = 0; i < PCA9685_CHANNELS; i++) {
+        regs[PCA9685_LED0_OFF_H + PCA9685_CHANNEL_REGS * i] = 0x10;
+    }
+}
+
+bool SimPwmDriver::begin(uint8_t prescale) {
+    std::lock_guard<std::recursive_mutex> lock(lock_);
+    logging::info(logging::Module::kServo, "Simulated PCA9685 at 0x{:x}", addr_);
+    reset();
+    resync();
+    if (prescale) {
+        uint8_t mode = (regs_[PCA9685_MODE1] | MODE1_EXTCLK) & ~MODE1_SLEEP;
+        write_(PCA9685_PRESCALE, &prescale, 1);
+        write_(PCA9685_MODE1, &mode, 1);
+    } else {
+        setPWMFreq(1000);
+    }
+    setOscillatorFrequency(FREQUENCY_OSCILLATOR);
+    return true;
+}
+
+void SimPwmDriver::reset() {
+    uint8_t mode = MODE1_RESTART;
+    write_(PCA9685_MODE1, &mode, 1);
+}
+
+void SimPwmDriver::setPWMFreq(float freq) {
+    freq = std::clamp(freq, 1.0f, 3500.0f);
+    float prescaleval = ((oscillator_freq_ / (freq * 4096.0)) + 0.5) - 1;
+    uint8_t prescale = (uint8_t)std::clamp<float>(prescaleval, PCA9685_PRESCALE_MIN, PCA9685_PRESCALE_MAX);
+
+    std::lock_guard<std::recursive_mutex> lock(lock_);
+    uint8_t mode = regs_[PCA9685_MODE1] | MODE1_AI;
+    write_(PCA9685_PRESCALE, &prescale, 1);
+    write_(PCA9685_MODE1, &mode, 1);
+}
+
+float SimPwmDriver::getPWMFreq() {
+    return (float)oscillator_freq_ / (4096.0f * (readPrescale() + 1));
+}
+
+uint8_t SimPwmDriver::readPrescale() {
+    return regs_[PCA9685_PRESCALE];
+}
+
+void SimPwmDriver::setOscillatorFrequency(uint32_t freq) {
+    oscillator_freq_ = freq;
+}
+
+uint32_t SimPwmDriver::getOscillatorFrequency() {
+    return oscillator_freq_;
+}
+
+uint16_t SimPwmDriver::ticks_(const uint8_t* regs) {
+    uint16_t on = (regs[1] << 8) + regs[0];
+    uint16_t off = (regs[3] << 8) + regs[2];
+    if (on & 0x1000) return 4096; // full on
+    if (off & 0x1000) return 0;   // full off
+    return off < on ? 4096 + off - on : off - on;
+}
+
+uint16_t SimPwmDriver::getPWM(uint8_t num) {
+    std::lock_guard<std::recursive_mutex> lock(lock_);
+    const uint8_t* regs = regs_ + PCA9685_LED0_ON_L + PCA9685_CHANNEL_REGS * num;
+    uint16_t on = (regs[1] << 8) + regs[0];
+    uint16_t off = (regs[3] << 8) + regs[2];
+    return off < on ? 4096 + off - on : off - on;
+}
+
+void SimPwmDriver::setPWM(uint8_t num, uint16_t on, uint16_t off) {
+    setMultiplePWM(num, 1, &on, &off);
+}
+
+void SimPwmDriver::setMultiplePWM(uint8_t first, uint8_t count, const uint16_t* on,
+                                  const uint16_t* off) {
+    if (first >= PCA9685_CHANNELS || count == 0) {
+        return;
+    }
+    count = std::min<uint8_t>(count, PCA9685_CHANNELS - first);
+    uint8_t data[kLedBytes];
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t* regs = data + i * PCA9685_CHANNEL_REGS;
+        regs[0] = on[i] & 0xFF;
+        regs[1] = on[i] >> 8;
+        regs[2] = off[i] & 0xFF;
+        regs[3] = off[i] >> 8;
+    }
+    std::lock_guard<std::recursive_mutex> lock(lock_);
+    write_(PCA9685_LED0_ON_L + PCA9685_CHANNEL_REGS * first, data, count * PCA9685_CHANNEL_REGS);
+}
+
+void SimPwmDriver::setPWMChannels(uint16_t mask, const uint16_t* on, const uint16_t* off) {
+    if (mask == 0) {
+        return;
+    }
+    std::lock_guard<std::recursive_mutex> lock(lock_);
+    uint8_t first = __builtin_ctz(mask);
+    uint8_t last = 31 - __builtin_clz(mask);
+    uint16_t range_on[PCA9685_CHANNELS];
+    uint16_t range_off[PCA9685_CHANNELS];
+    for (uint8_t num = first; num <= last; num++) {
+        if (mask & (1u << num)) {
+            range_on[num - first] = on[num];
+            range_off[num - first] = off[num];
+        } else {
+            const uint8_t* regs = regs_ + PCA9685_LED0_ON_L + PCA9685_CHANNEL_REGS * num;
+            range_on[num - first] = (regs[1] << 8) + regs[0];
+            range_off[num - first] = (regs[3] << 8) + regs[2];
+        }
+    }
+    setMultiplePWM(first, last - first + 1, range_on, range_off);
+}
+
+void SimPwmDriver::setAllPWM(uint16_t on, uint16_t off) {
+    uint8_t data[PCA9685_CHANNEL_REGS] = {(uint8_t)(on & 0xFF), (uint8_t)(on >> 8),
+                                          (uint8_t)(off & 0xFF), (uint8_t)(off >> 8)};
+    std::lock_guard<std::recursive_mutex> lock(lock_);
+    write_(PCA9685_ALLLED_ON_L, data, sizeof(data));
+}
+
+void SimPwmDriver::writeMicroseconds(uint8_t num, uint16_t Microseconds) {
+    // Equation 1, datasheet section 7.3.5, as in the real driver
+    double pulselength = 1000000.0 * (readPrescale() + 1) / oscillator_freq_;
+    setPWM(num, 0, Microseconds / pulselength);
+}
+
+bool SimPwmDriver::resync() {
+    std::lock_guard<std::recursive_mutex> lock(lock_);
+    // MODE1, MODE2 and PRESCALE reads, then the LEDn block
+    faults_.access(3 * 4 * byte_ns_ + (kLedBytes + 2) * byte_ns_);
+    bool in_sync = chip_[PCA9685_MODE1] == regs_[PCA9685_MODE1] &&
+                   chip_[PCA9685_MODE2] == regs_[PCA9685_MODE2] &&
+                   chip_[PCA9685_PRESCALE] == regs_[PCA9685_PRESCALE] &&
+                   std::memcmp(chip_ + PCA9685_LED0_ON_L, regs_ + PCA9685_LED0_ON_L, kLedBytes) == 0;
+    std::memcpy(regs_, chip_, sizeof(regs_));
+    return in_sync;
+}
+
+double SimPwmDriver::outputMicroseconds(uint8_t num) {
+    std::lock_guard<std::recursive_mutex> lock(lock_);
+    double pulselength = 1000000.0 * (chip_[PCA9685_PRESCALE] + 1) / oscillator_freq_;
+    return ticks_(chip_ + PCA9685_LED0_ON_L + PCA9685_CHANNEL_REGS * num) * pulselength;
+}
+
+void SimPwmDriver::brownOut() {
+    std::lock_guard<std::recursive_mutex> lock(lock_);
+    power_on_(chip_);
+}
+
+void SimPwmDriver::write_(uint8_t addr, const uint8_t* data, size_t len) {
+    len = std::min<size_t>(len, kLedBytes);
+    // slave address + register + payload; the shadow follows the intent
+    // either way, the chip only when the transfer succeeds
+    bool ok = faults_.access((len + 2) * byte_ns_);
+    uint8_t* targets[2] = {regs_, ok ? chip_ : nullptr};
+    if (!ok) {
+        logging::error(logging::Module::kServo, "PCA9685 0x{:x} block write to register 0x{:x} failed",
+                       addr_, addr);
+    }
+    for (uint8_t* file : targets) {
+        if (!file) continue;
+        if (addr == PCA9685_ALLLED_ON_L) {
+            for (uint8_t i = 0; i < PCA9685_CHANNELS; i++) {
+                std::memcpy(file + PCA9685_LED0_ON_L + PCA9685_CHANNEL_REGS * i, data,
+                            std::min<size_t>(len, PCA9685_CHANNEL_REGS));
+            }
+        } else {
+            std::memcpy(file + addr, data, std::min<size_t>(len, 256 - addr));
+        }
+        if (addr == PCA9685_MODE1) {
+            file[PCA9685_MODE1] &= ~MODE1_RESTART;
+        }
+    }
+}
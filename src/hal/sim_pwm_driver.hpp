@@ -0,0 +1,54 @@
+#pragma once
+
+#include "pwm_driver.hpp"
+#include "sim_faults.hpp"
+
+#include <mutex>
+
+/*!
+ *  @brief  PCA9685 stand-in. Keeps the chip's register file and the driver's
+ *  shadow of it separately, the way Adafruit_PWMServoDriver does, so a write
+ *  that fails leaves the chip stale until resync() notices. Each transfer
+ *  costs its I2C time at 400 kHz plus the configured latency.
+ */
+class SimPwmDriver : public PwmDriver {
+  public:
+    SimPwmDriver(const SimSettings& settings, uint8_t addr = PCA9685_I2C_ADDRESS);
+
+    bool begin(uint8_t prescale = 0) override;
+    void reset() override;
+    void setPWMFreq(float freq) override;
+    float getPWMFreq() override;
+    uint8_t readPrescale() override;
+    void setOscillatorFrequency(uint32_t freq) override;
+    uint32_t getOscillatorFrequency() override;
+
+    uint16_t getPWM(uint8_t num) override;
+    void setPWM(uint8_t num, uint16_t on, uint16_t off) override;
+    void setMultiplePWM(uint8_t first, uint8_t count, const uint16_t* on,
+                        const uint16_t* off) override;
+    void setPWMChannels(uint16_t mask, const uint16_t* on,
+                        const uint16_t* off) override;
+    void setAllPWM(uint16_t on, uint16_t off) override;
+    void writeMicroseconds(uint8_t num, uint16_t Microseconds) override;
+    bool resync() override;
+
+    // Pulse width the chip is actually outputting on num, in microseconds
+    double outputMicroseconds(uint8_t num);
+    // Puts the chip back to its power-on registers, as a supply dip would,
+    // without the driver's shadow noticing
+    void brownOut();
+
+  private:
+    static void power_on_(uint8_t* regs);
+    void write_(uint8_t addr, const uint8_t* data, size_t len);
+    static uint16_t ticks_(const uint8_t* regs);
+
+    FaultInjector faults_;
+    uint8_t addr_;
+    uint64_t byte_ns_; // one byte plus ack on the bus
+    uint32_t oscillator_freq_ = FREQUENCY_OSCILLATOR;
+    uint8_t chip_[256] = {};
+    uint8_t regs_[256] = {};
+    std::recursive_mutex lock_;
+};
@@ -0,0 +1,47 @@
+#include "sim_relay_expander.hpp"
+#include "../logging/log.hpp"
+
+#include <stdexcept>
+
+namespace {
+constexpr int kRetries = 10;
+}
+
+SimRelayExpander::SimRelayExpander(const SimSettings& settings)
+    : faults_(settings.i2c),
+      register_write_ns_(settings.i2c_hz ? 3 * 9 * 1000000000ull / settings.i2c_hz : 0) {}
+
+void SimRelayExpander::configure_port(uint8_t port, uint8_t direction) {
+    faults_.access(register_write_ns_);
+    uint16_t mask = port == 0 ? 0x00FF : 0xFF00;
+    uint16_t bits = port == 0 ? direction : uint16_t(direction << 8);
+    config_ = (config_ & ~mask) | bits;
+}
+
+void SimRelayExpander::write_output(std::bitset<16> state) {
+    // both ports, as the real driver does
+    for (int attempt = 0; attempt <= kRetries; attempt++) {
+        bool ok = faults_.access(register_write_ns_);
+        ok &= faults_.access(register_write_ns_);
+        if (ok) {
+            output_ = static_cast<uint16_t>(state.to_ulong());
+            if (attempt) {
+                logging::info(logging::Module::kRelay, "Relay state written successfully after {} retries",
+                              attempt);
+            }
+            return;
+        }
+        logging::warn(logging::Module::kRelay, "Issue with writing relay state. Retrying...");
+    }
+    throw std::runtime_error("Failed to write relay state after 10 tries. Aborting program...");
+}
+
+uint8_t SimRelayExpander::read_input(uint8_t port) {
+    // select + repeated start + read
+    if (!faults_.access(2 * register_write_ns_)) {
+        throw std::runtime_error("Failed to read from I2C register");
+    }
+    // inputs float high, outputs read back their level
+    uint16_t level = (output_ & ~config_) | config_;
+    return port == 0 ? level & 0xFF : level >> 8;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "relay_expander.hpp"
+#include "sim_faults.hpp"
+
+#include <atomic>
+
+class SimRelayExpander : public RelayExpander {
+    // TCA9535 stand-in: keeps the port registers, charges I2C transfer time
+    // per register access and fails accesses at the configured rate. Writes
+    // retry like the real driver and throw when retries run out.
+  public:
+    explicit SimRelayExpander(const SimSettings& settings);
+
+    void configure_port(uint8_t port, uint8_t direction) override;
+    void write_output(std::bitset<16> state) override;
+    uint8_t read_input(uint8_t port) override;
+
+    std::bitset<16> state() const { return output_.load(); }
+
+  private:
+    FaultInjector faults_;
+    uint64_t register_write_ns_; // address + register + data byte
+    std::atomic<uint16_t> output_{0};
+    std::atomic<uint16_t> config_{0xFFFF}; // power-on: all inputs
+};
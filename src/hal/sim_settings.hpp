@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Plain settings for the simulated devices, filled from the "hal" section of
+// the config file.
+
+struct SimWaveform {
+    std::string shape = "sine"; // sine, square, triangle, sawtooth, constant
+    double amplitude = 1.0;     // volts, peak
+    double offset = 0.0;        // volts
+    double frequency_hz = 1.0;
+    double noise = 0.0;         // gaussian, volts RMS
+
+    bool operator==(const SimWaveform&) const = default;
+};
+
+struct SimFaults {
+    uint32_t latency_us = 0; // added to every access
+    uint32_t jitter_us = 0;  // uniform extra latency on top
+    double fault_rate = 0;   // probability an access fails, 0..1
+
+    bool operator==(const SimFaults&) const = default;
+};
+
+struct SimGpioInput {
+    double frequency_hz = 0; // full cycles per second, 0 holds the level
+    double phase_deg = 0;    // 90 on the second line of a pair gives quadrature
+
+    bool operator==(const SimGpioInput&) const = default;
+};
+
+struct SimSettings {
+    std::vector<int> hats = {0};
+    SimWaveform waveform;                 // every analog channel...
+    std::map<int, SimWaveform> channels;  // ...unless overridden by channel number
+    std::map<int, SimGpioInput> gpio_inputs;
+    std::map<int, int> gpio_loopback; // output pin -> input pin it drives
+
+    // Defaults approximate the real parts: an MCC128 software-paced read
+    // takes a few tens of microseconds; I2C transfer time is modelled per
+    // byte at i2c_hz on top of the i2c settings (0 makes transfers free).
+    uint32_t i2c_hz = 400000;
+    SimFaults daq{20, 5, 0};
+    SimFaults i2c;
+    SimFaults gpio;
+
+    bool operator==(const SimSettings&) const = default;
+};
+
+struct HalSettings {
+    std::string backend = "hardware"; // "hardware" or "sim"
+    SimSettings sim;
+
+    bool operator==(const HalSettings&) const = default;
+};
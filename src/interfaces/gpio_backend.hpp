@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct GPIO_Event {
+    int pin;
+    int value;             // level after the edge: 1 rising, 0 falling
+    uint64_t timestamp_ns; // kernel event timestamp
+};
+
+enum class GPIO_Direction : uint8_t { kUnused, kInput, kOutput };
+
+// Clock the kernel stamps edge events with. The v1 API cannot choose and
+// gets whatever the kernel uses (monotonic since Linux 5.7).
+enum class GPIO_EventClock : uint8_t { kMonotonic, kRealtime };
+
+struct GPIO_LineConfig {
+    int pin;
+    int value;            // initial level, outputs only
+    uint32_t debounce_us; // kernel debounce period, inputs only
+};
+
+class GPIO_Backend {
+    // The line-request half of GPIO_Manager. One libgpiod implementation is
+    // compiled in, picked by the gpiod_api meson option: v1 (gpiod_line_bulk)
+    // or v2 (gpiod_line_request). SimGpioBackend stands in for both off the
+    // Pi.
+  public:
+    virtual ~GPIO_Backend() = default;
+
+    // Each call replaces the previous request of that direction and leaves
+    // the other one alone. Level and event arrays below are in the order the
+    // lines were requested.
+    virtual bool request_outputs(const std::vector<GPIO_LineConfig>& lines) = 0;
+    virtual bool request_inputs(const std::vector<GPIO_LineConfig>& lines,
+                                GPIO_EventClock clock) = 0;
+    // Applies new debounce periods and event clock to the requested inputs
+    // (the same lines, in the same order). The default re-requests them;
+    // backends that can change a live request keep the lines and their
+    // queued edges.
+    virtual bool reconfigure_inputs(const std::vector<GPIO_LineConfig>& lines,
+                                    GPIO_EventClock clock) {
+        return request_inputs(lines, clock);
+    }
+    virtual void release_outputs() = 0;
+    virtual void release_inputs() = 0;
+    void release() {
+        release_inputs();
+        release_outputs();
+    }
+
+    virtual bool set_outputs(const int* levels) = 0;
+    virtual bool get_inputs(int* levels) = 0;
+
+    // fds that become readable when input edges are pending, and a batched
+    // read of whatever is queued on one of them
+    virtual std::vector<int> event_fds() = 0;
+    virtual int read_events(int fd, GPIO_Event* events, int max_events) = 0;
+
+    virtual bool supports_debounce() const = 0;
+};
+
+std::unique_ptr<GPIO_Backend> make_gpio_backend(const std::string& chipname);
@@ -0,0 +1,151 @@
+#include "gpio_backend.hpp"
+#include "../logging/log.hpp"
+
+#include <algorithm>
+#include <gpiod.h>
+#include <map>
+#include <stdexcept>
+
+namespace {
+
+constexpr int kMaxEventsPerRead = 16; // v1 kernel kfifo depth per line
+
+class GPIO_BackendV1 : public GPIO_Backend {
+    // libgpiod 1.x: outputs and inputs are each one gpiod_line_bulk request.
+    // Edge events are requested per line, so every input has its own fd.
+  public:
+    explicit GPIO_BackendV1(const std::string& chipname) {
+        chip_ = gpiod_chip_open(chipname.c_str());
+        if (!chip_) {
+            throw std::runtime_error("Failed to open GPIO chip: " + chipname);
+        }
+    }
+
+    ~GPIO_BackendV1() override {
+        release();
+        gpiod_chip_close(chip_);
+    }
+
+    bool request_outputs(const std::vector<GPIO_LineConfig>& lines) override {
+        release_bulk_(outputs_);
+        int levels[GPIOD_LINE_BULK_MAX_LINES];
+        if (!collect_(lines, outputs_, levels)) {
+            return false;
+        }
+        if (gpiod_line_bulk_num_lines(&outputs_) &&
+            gpiod_line_request_bulk_output(&outputs_, "GpioControl", levels) < 0) {
+            gpiod_line_bulk_init(&outputs_);
+            return false;
+        }
+        return true;
+    }
+
+    bool request_inputs(const std::vector<GPIO_LineConfig>& lines,
+                        GPIO_EventClock) override {
+        release_bulk_(inputs_);
+        fd_pins_.clear();
+        for (const auto& line : lines) {
+            if (line.debounce_us) {
+                logging::warn(logging::Module::kGpio,
+                              "GPIO {}: debounce needs the libgpiod v2 backend", line.pin);
+            }
+        }
+        if (!collect_(lines, inputs_, nullptr)) {
+            return false;
+        }
+        // both-edge events; the lines can still be read with get_value
+        if (gpiod_line_bulk_num_lines(&inputs_) &&
+            gpiod_line_request_bulk_both_edges_events(&inputs_, "GpioControl") < 0) {
+            gpiod_line_bulk_init(&inputs_);
+            return false;
+        }
+        for (unsigned int i = 0; i < gpiod_line_bulk_num_lines(&inputs_); i++) {
+            gpiod_line* line = gpiod_line_bulk_get_line(&inputs_, i);
+            fd_pins_[gpiod_line_event_get_fd(line)] = {lines[i].pin, line};
+        }
+        return true;
+    }
+
+    void release_outputs() override { release_bulk_(outputs_); }
+
+    void release_inputs() override {
+        release_bulk_(inputs_);
+        fd_pins_.clear();
+    }
+
+    bool set_outputs(const int* levels) override {
+        return gpiod_line_set_value_bulk(&outputs_, levels) == 0;
+    }
+
+    bool get_inputs(int* levels) override {
+        // event-requested lines are read one ioctl per line under v1
+        return gpiod_line_get_value_bulk(&inputs_, levels) == 0;
+    }
+
+    std::vector<int> event_fds() override {
+        std::vector<int> fds;
+        for (const auto& [fd, input] : fd_pins_) fds.push_back(fd);
+        return fds;
+    }
+
+    int read_events(int fd, GPIO_Event* events, int max_events) override {
+        auto it = fd_pins_.find(fd);
+        if (it == fd_pins_.end()) {
+            return 0;
+        }
+        gpiod_line_event raw[kMaxEventsPerRead];
+        int count = gpiod_line_event_read_multiple(
+            it->second.line, raw, std::min(max_events, kMaxEventsPerRead));
+        for (int e = 0; e < count; e++) {
+            events[e].pin = it->second.pin;
+            events[e].value =
+                raw[e].event_type == GPIOD_LINE_EVENT_RISING_EDGE ? 1 : 0;
+            events[e].timestamp_ns =
+                static_cast<uint64_t>(raw[e].ts.tv_sec) * 1000000000ull +
+                raw[e].ts.tv_nsec;
+        }
+        return count;
+    }
+
+    bool supports_debounce() const override { return false; }
+
+  private:
+    struct Input {
+        int pin;
+        gpiod_line* line;
+    };
+
+    bool collect_(const std::vector<GPIO_LineConfig>& lines,
+                  gpiod_line_bulk& bulk, int* levels) {
+        gpiod_line_bulk_init(&bulk);
+        for (const auto& config : lines) {
+            gpiod_line* line = gpiod_chip_get_line(chip_, config.pin);
+            if (!line) {
+                logging::error(logging::Module::kGpio, "Failed to get line for GPIO {}", config.pin);
+                gpiod_line_bulk_init(&bulk);
+                return false;
+            }
+            if (levels) levels[gpiod_line_bulk_num_lines(&bulk)] = config.value;
+            gpiod_line_bulk_add(&bulk, line);
+        }
+        return true;
+    }
+
+    static void release_bulk_(gpiod_line_bulk& bulk) {
+        if (gpiod_line_bulk_num_lines(&bulk)) {
+            gpiod_line_release_bulk(&bulk);
+        }
+        gpiod_line_bulk_init(&bulk);
+    }
+
+    gpiod_chip* chip_;
+    gpiod_line_bulk outputs_ = GPIOD_LINE_BULK_INITIALIZER;
+    gpiod_line_bulk inputs_ = GPIOD_LINE_BULK_INITIALIZER;
+    std::map<int, Input> fd_pins_;
+};
+
+} // namespace
+
+std::unique_ptr<GPIO_Backend> make_gpio_backend(const std::string& chipname) {
+    return std::make_unique<GPIO_BackendV1>(chipname);
+}
@@ -0,0 +1,209 @@
+#include "gpio_backend.hpp"
+
+#include <algorithm>
+#include <gpiod.h>
+#include <stdexcept>
+
+namespace {
+
+constexpr size_t kEventBufferSize = 64; // edges drained per read
+
+// Both-edge input with the line's debounce, stamped on clock
+auto input_settings(GPIO_EventClock clock) {
+    auto event_clock = clock == GPIO_EventClock::kRealtime
+                           ? GPIOD_LINE_CLOCK_REALTIME
+                           : GPIOD_LINE_CLOCK_MONOTONIC;
+    return [event_clock](gpiod_line_settings* settings, const GPIO_LineConfig& line) {
+        gpiod_line_settings_set_direction(settings, GPIOD_LINE_DIRECTION_INPUT);
+        gpiod_line_settings_set_edge_detection(settings, GPIOD_LINE_EDGE_BOTH);
+        gpiod_line_settings_set_debounce_period_us(settings, line.debounce_us);
+        gpiod_line_settings_set_event_clock(settings, event_clock);
+    };
+}
+
+class GPIO_BackendV2 : public GPIO_Backend {
+    // libgpiod 2.x: outputs and inputs are each one gpiod_line_request, so
+    // bulk get/set is a single ioctl and all input edges arrive on one fd,
+    // read in batches into an edge-event buffer. Debounce is per line and
+    // done by the kernel.
+  public:
+    explicit GPIO_BackendV2(const std::string& chipname) {
+        chip_ = gpiod_chip_open(chipname.c_str());
+        if (!chip_) {
+            throw std::runtime_error("Failed to open GPIO chip: " + chipname);
+        }
+        buffer_ = gpiod_edge_event_buffer_new(kEventBufferSize);
+        if (!buffer_) {
+            gpiod_chip_close(chip_);
+            throw std::runtime_error("Failed to allocate GPIO edge event buffer");
+        }
+    }
+
+    ~GPIO_BackendV2() override {
+        release();
+        gpiod_edge_event_buffer_free(buffer_);
+        gpiod_chip_close(chip_);
+    }
+
+    bool request_outputs(const std::vector<GPIO_LineConfig>& lines) override {
+        release_(outputs_);
+        output_count_ = lines.size();
+        if (lines.empty()) {
+            return true;
+        }
+        outputs_ = request_(lines, [](gpiod_line_settings* settings,
+                                      const GPIO_LineConfig& line) {
+            gpiod_line_settings_set_direction(settings, GPIOD_LINE_DIRECTION_OUTPUT);
+            gpiod_line_settings_set_output_value(
+                settings, line.value ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE);
+        });
+        if (!outputs_) output_count_ = 0;
+        return outputs_ != nullptr;
+    }
+
+    bool request_inputs(const std::vector<GPIO_LineConfig>& lines,
+                        GPIO_EventClock clock) override {
+        release_(inputs_);
+        input_count_ = lines.size();
+        if (lines.empty()) {
+            return true;
+        }
+        inputs_ = request_(lines, input_settings(clock));
+        if (!inputs_) input_count_ = 0;
+        return inputs_ != nullptr;
+    }
+
+    // The request stays open, so no edge is lost while debounce or the
+    // clock changes
+    bool reconfigure_inputs(const std::vector<GPIO_LineConfig>& lines,
+                            GPIO_EventClock clock) override {
+        if (!inputs_ || lines.size() != input_count_) {
+            return request_inputs(lines, clock);
+        }
+        gpiod_line_config* line_config = line_config_(lines, input_settings(clock));
+        bool ok = line_config && gpiod_line_request_reconfigure_lines(inputs_, line_config) == 0;
+        if (line_config) gpiod_line_config_free(line_config);
+        return ok;
+    }
+
+    void release_outputs() override {
+        release_(outputs_);
+        output_count_ = 0;
+    }
+
+    void release_inputs() override {
+        release_(inputs_);
+        input_count_ = 0;
+    }
+
+    bool set_outputs(const int* levels) override {
+        gpiod_line_value values[kMaxLines];
+        for (size_t i = 0; i < output_count_; i++) {
+            values[i] = levels[i] ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE;
+        }
+        return outputs_ && gpiod_line_request_set_values(outputs_, values) == 0;
+    }
+
+    bool get_inputs(int* levels) override {
+        gpiod_line_value values[kMaxLines];
+        if (!inputs_ || gpiod_line_request_get_values(inputs_, values) < 0) {
+            return false;
+        }
+        for (size_t i = 0; i < input_count_; i++) {
+            levels[i] = values[i] == GPIOD_LINE_VALUE_ACTIVE ? 1 : 0;
+        }
+        return true;
+    }
+
+    std::vector<int> event_fds() override {
+        if (!inputs_) return {};
+        return {gpiod_line_request_get_fd(inputs_)};
+    }
+
+    int read_events(int fd, GPIO_Event* events, int max_events) override {
+        if (!inputs_ || fd != gpiod_line_request_get_fd(inputs_)) {
+            return 0;
+        }
+        size_t max = std::min<size_t>(max_events, kEventBufferSize);
+        int count = gpiod_line_request_read_edge_events(inputs_, buffer_, max);
+        for (int e = 0; e < count; e++) {
+            gpiod_edge_event* event = gpiod_edge_event_buffer_get_event(buffer_, e);
+            events[e].pin = static_cast<int>(gpiod_edge_event_get_line_offset(event));
+            events[e].value = gpiod_edge_event_get_event_type(event) ==
+                                      GPIOD_EDGE_EVENT_RISING_EDGE
+                                  ? 1
+                                  : 0;
+            events[e].timestamp_ns = gpiod_edge_event_get_timestamp_ns(event);
+        }
+        return count;
+    }
+
+    bool supports_debounce() const override { return true; }
+
+  private:
+    static constexpr size_t kMaxLines = 64;
+
+    // One settings object per line so each can carry its own debounce
+    // period; offsets keep the order they were given in. nullptr on failure.
+    template <typename Apply>
+    static gpiod_line_config* line_config_(const std::vector<GPIO_LineConfig>& lines,
+                                           Apply apply) {
+        gpiod_line_config* line_config = gpiod_line_config_new();
+        bool ok = line_config != nullptr;
+        for (size_t i = 0; ok && i < lines.size(); i++) {
+            gpiod_line_settings* settings = gpiod_line_settings_new();
+            if (!settings) {
+                ok = false;
+                break;
+            }
+            apply(settings, lines[i]);
+            unsigned int offset = static_cast<unsigned int>(lines[i].pin);
+            ok = gpiod_line_config_add_line_settings(line_config, &offset, 1,
+                                                     settings) == 0;
+            gpiod_line_settings_free(settings);
+        }
+        if (!ok && line_config) {
+            gpiod_line_config_free(line_config);
+            return nullptr;
+        }
+        return line_config;
+    }
+
+    template <typename Apply>
+    gpiod_line_request* request_(const std::vector<GPIO_LineConfig>& lines,
+                                 Apply apply) {
+        gpiod_line_config* line_config = line_config_(lines, apply);
+        gpiod_request_config* request_config = gpiod_request_config_new();
+        gpiod_line_request* request = nullptr;
+        bool ok = line_config && request_config;
+        if (ok) {
+            gpiod_request_config_set_consumer(request_config, "GpioControl");
+            gpiod_request_config_set_event_buffer_size(request_config,
+                                                       kEventBufferSize * 4);
+            request = gpiod_chip_request_lines(chip_, request_config, line_config);
+        }
+        if (request_config) gpiod_request_config_free(request_config);
+        if (line_config) gpiod_line_config_free(line_config);
+        return request;
+    }
+
+    static void release_(gpiod_line_request*& request) {
+        if (request) {
+            gpiod_line_request_release(request);
+            request = nullptr;
+        }
+    }
+
+    gpiod_chip* chip_;
+    gpiod_edge_event_buffer* buffer_;
+    gpiod_line_request* outputs_ = nullptr;
+    gpiod_line_request* inputs_ = nullptr;
+    size_t output_count_ = 0;
+    size_t input_count_ = 0;
+};
+
+} // namespace
+
+std::unique_ptr<GPIO_Backend> make_gpio_backend(const std::string& chipname) {
+    return std::make_unique<GPIO_BackendV2>(chipname);
+}
@@ -0,0 +1,72 @@
+#include "gpio_counter.hpp"
+
+#include <algorithm>
+
+void GPIO_Counter::configure(const GPIO_CounterConfig& config) {
+    edge_ = config.edge;
+    window_ns_ = static_cast<uint64_t>(std::max<uint32_t>(config.window_ms, 1)) * 1000000ull;
+    scale_ = config.scale;
+    reset();
+}
+
+void GPIO_Counter::reset() {
+    count_ = 0;
+    last_ns_ = 0;
+    period_ns_ = 0;
+    frequency_ = 0.0;
+    window_start_ns_ = 0;
+    window_start_count_ = 0;
+}
+
+void GPIO_Counter::on_edge(uint64_t timestamp_ns) {
+    uint64_t count = count_.load(std::memory_order_relaxed) + 1;
+    uint64_t last = last_ns_.load(std::memory_order_relaxed);
+    if (last && timestamp_ns > last) {
+        period_ns_.store(timestamp_ns - last, std::memory_order_relaxed);
+    }
+
+    if (!window_start_ns_) {
+        window_start_ns_ = timestamp_ns;
+        window_start_count_ = count;
+    } else if (timestamp_ns - window_start_ns_ >= window_ns_.load(std::memory_order_relaxed)) {
+        frequency_.store(static_cast<double>(count - window_start_count_) * 1e9 /
+                             static_cast<double>(timestamp_ns - window_start_ns_),
+                         std::memory_order_relaxed);
+        window_start_ns_ = timestamp_ns;
+        window_start_count_ = count;
+    }
+
+    last_ns_.store(timestamp_ns, std::memory_order_relaxed);
+    count_.store(count, std::memory_order_release);
+}
+
+GPIO_CounterReading GPIO_Counter::reading(int pin, uint64_t now_ns) const {
+    GPIO_CounterReading r{};
+    r.pin = pin;
+    r.count = count_.load(std::memory_order_acquire);
+    r.timestamp_ns = last_ns_.load(std::memory_order_relaxed);
+
+    double period_ns = static_cast<double>(period_ns_.load(std::memory_order_relaxed));
+    double frequency = frequency_.load(std::memory_order_relaxed);
+    if (frequency == 0.0 && period_ns > 0.0) {
+        // first window not complete yet
+        frequency = 1e9 / period_ns;
+    }
+
+    // no edge for longer than both the window and the last period: the true
+    // period is at least the time since the last edge
+    if (r.timestamp_ns && now_ns > r.timestamp_ns) {
+        double idle_ns = static_cast<double>(now_ns - r.timestamp_ns);
+        if (idle_ns > static_cast<double>(window_ns_.load(std::memory_order_relaxed)) && idle_ns > period_ns) {
+            period_ns = idle_ns;
+            frequency = std::min(frequency, 1e9 / idle_ns);
+        }
+    }
+
+    double scale = scale_.load(std::memory_order_relaxed);
+    r.period_us = period_ns / 1000.0;
+    r.frequency_hz = frequency;
+    r.total = static_cast<double>(r.count) * scale;
+    r.rate = frequency * scale;
+    return r;
+}
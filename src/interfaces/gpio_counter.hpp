@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+enum class GPIO_Edge : uint8_t { kRising, kFalling, kBoth };
+
+struct GPIO_CounterConfig {
+    GPIO_Edge edge = GPIO_Edge::kRising;
+    uint32_t window_ms = 250; // frequency is averaged over at least this long
+    double scale = 1.0;       // engineering units per pulse, e.g. 1 / K-factor
+};
+
+struct GPIO_CounterReading {
+    int pin;
+    uint64_t count;
+    double period_us;      // between the last two counted edges
+    double frequency_hz;   // counted edges per second over the last window
+    double total;          // count * scale
+    double rate;           // frequency * scale
+    uint64_t timestamp_ns; // last counted edge, on the GPIO event clock
+};
+
+class GPIO_Counter {
+    // Pulse counter for one input line, fed with kernel-timestamped edges.
+    //
+    // Frequency is measured reciprocally: once a window has passed, it is the
+    // number of edges since the window opened divided by the time between
+    // the first and last of them, both taken from edge timestamps. That
+    // keeps full resolution at low rates where a fixed gate time would only
+    // see a handful of pulses.
+    //
+    // configure(), reset() and on_edge() are called with GPIO_Manager's
+    // config mutex held; reading() is lock-free from any thread, so
+    // everything it reads, the configuration included, is atomic.
+public:
+    void configure(const GPIO_CounterConfig& config);
+    void reset();
+
+    bool counts(int value) const {
+        const GPIO_Edge edge = edge_.load(std::memory_order_relaxed);
+        return edge == GPIO_Edge::kBoth || (value != 0) == (edge == GPIO_Edge::kRising);
+    }
+    void on_edge(uint64_t timestamp_ns);
+
+    // now_ns is the current time on the event clock. A pulse train that
+    // stops shows as a frequency decaying towards zero instead of holding
+    // the last value.
+    GPIO_CounterReading reading(int pin, uint64_t now_ns) const;
+
+private:
+    std::atomic<GPIO_Edge> edge_{GPIO_Edge::kRising};
+    std::atomic<uint64_t> window_ns_{250000000};
+    std::atomic<double> scale_{1.0};
+
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> last_ns_{0};
+    std::atomic<uint64_t> period_ns_{0};
+    std::atomic<double> frequency_{0.0};
+
+    // start of the current frequency window, writer side only
+    uint64_t window_start_ns_ = 0;
+    uint64_t window_start_count_ = 0;
+};
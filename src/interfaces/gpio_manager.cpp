@@ -1,113 +1,475 @@
 #include "gpio_manager.hpp"
-#include <iostream>
+#include "../logging/log.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
 
-GPIO_Manager::GPIO_Manager(const std::string& chipname) {
-    chip_ = gpiod_chip_open(chipname.c_str());
-    if (!chip_) {
-        throw std::runtime_error("Failed to open GPIO chip: " + chipname);
-    }
-    else {
-        std::cout << "GPIO chip opened successfully: " << chipname << std::endl;
+namespace {
+// epoll user data for the wake eventfd; event fds carry the fd itself
+constexpr uint64_t kWakeToken = UINT64_MAX;
+constexpr int kMaxEventsPerRead = 64;
+}
+
+GPIO_Manager::GPIO_Manager(const std::string& chipname)
+    : GPIO_Manager(make_gpio_backend(chipname)) {
+    logging::info(logging::Module::kGpio, "GPIO chip opened successfully: {}", chipname);
+}
+
+GPIO_Manager::GPIO_Manager(std::unique_ptr<GPIO_Backend> backend)
+    : backend_(std::move(backend)) {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (epoll_fd_ < 0 || wake_fd_ < 0) {
+        throw std::runtime_error("Failed to set up GPIO event polling");
     }
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = kWakeToken;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev);
 }
 
 GPIO_Manager::~GPIO_Manager() {
-    std::lock_guard<std::mutex> lock(mutex_);
-    for (auto& [pin, info] : pins_) {
-        if (info.line) {
-            gpiod_line_release(info.line);
-        }
+    stop_event_monitor();
+
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    release_(true, true);
+    if (epoll_fd_ >= 0) close(epoll_fd_);
+    if (wake_fd_ >= 0) close(wake_fd_);
+}
+
+bool GPIO_Manager::set_direction(int pin, GPIO_Direction direction) {
+    if (!valid_(pin) || direction == GPIO_Direction::kUnused) {
+        logging::warn(logging::Module::kGpio, "Invalid direction request for GPIO {}", pin);
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    std::lock_guard<std::mutex> output_lock(output_mutex_);
+
+    Line& line = lines_[pin];
+    const GPIO_Direction previous = line.direction;
+    if (previous == direction) {
+        return true;
+    }
+    // outputs and inputs are each held as one bulk request; only the groups
+    // the pin leaves or joins are re-requested, the other keeps running
+    const bool outputs = previous == GPIO_Direction::kOutput || direction == GPIO_Direction::kOutput;
+    const bool inputs = previous == GPIO_Direction::kInput || direction == GPIO_Direction::kInput;
+    std::array<GPIO_Direction, kMaxLines> before;
+    for (int p = 0; p < kMaxLines; p++) {
+        before[p] = lines_[p].direction;
+    }
+
+    release_(outputs, inputs);
+    line.direction = direction;
+    if (direction != GPIO_Direction::kInput) {
+        line.counting = false;
     }
-    if (chip_) {
-        gpiod_chip_close(chip_);
+    if (previous != GPIO_Direction::kOutput) {
+        line.value = 0;
     }
+    if (!request_(outputs, inputs)) {
+        // a failed request leaves its whole group unowned; put the groups
+        // back as they were rather than drop every line in them
+        logging::error(logging::Module::kGpio, "Failed to set direction for GPIO {}", pin);
+        release_(outputs, inputs);
+        for (int p = 0; p < kMaxLines; p++) {
+            lines_[p].direction = before[p];
+        }
+        request_(outputs, inputs);
+        return false;
+    }
+    return true;
 }
 
-bool GPIO_Manager::set_direction(int pin, const std::string& direction) {
-    std::lock_guard<std::mutex> lock(mutex_);
+bool GPIO_Manager::configure(const std::vector<int>& outputs, const std::vector<int>& inputs,
+                             const std::map<int, uint32_t>& debounce_us, GPIO_EventClock clock) {
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    std::lock_guard<std::mutex> output_lock(output_mutex_);
 
-    if (pins_.count(pin) && pins_[pin].line) {
-        gpiod_line_release(pins_[pin].line);
+    // lines in neither list are given back; a pin in both is an input
+    std::array<GPIO_Direction, kMaxLines> next;
+    next.fill(GPIO_Direction::kUnused);
+    for (const auto* pins : {&outputs, &inputs}) {
+        for (int pin : *pins) {
+            if (!valid_(pin)) {
+                logging::warn(logging::Module::kGpio, "Failed to get line for GPIO {}", pin);
+                continue;
+            }
+            next[pin] = pins == &outputs ? GPIO_Direction::kOutput : GPIO_Direction::kInput;
+        }
+    }
+
+    // a group is only re-requested if its set of lines changes; new debounce
+    // periods or clock alone are applied to the live input request
+    bool outputs_changed = false;
+    bool inputs_changed = false;
+    bool settings_changed = clock != clock_;
+    for (int pin = 0; pin < kMaxLines; pin++) {
+        const GPIO_Direction previous = lines_[pin].direction;
+        if (previous != next[pin]) {
+            outputs_changed |= previous == GPIO_Direction::kOutput || next[pin] == GPIO_Direction::kOutput;
+            inputs_changed |= previous == GPIO_Direction::kInput || next[pin] == GPIO_Direction::kInput;
+        }
+        auto it = debounce_us.find(pin);
+        const uint32_t period = it != debounce_us.end() ? it->second : 0;
+        settings_changed |= next[pin] == GPIO_Direction::kInput && period != lines_[pin].debounce_us;
+        lines_[pin].debounce_us = period;
+    }
+
+    release_(outputs_changed, inputs_changed);
+    for (int pin = 0; pin < kMaxLines; pin++) {
+        Line& line = lines_[pin];
+        if (next[pin] != line.direction) {
+            line.value = 0;
+        }
+        if (next[pin] != GPIO_Direction::kInput) {
+            line.counting = false;
+        }
+        line.direction = next[pin];
+    }
+    clock_ = clock;
+    bool ok = request_(outputs_changed, inputs_changed);
+    if (!inputs_changed && settings_changed) {
+        ok = reconfigure_inputs_() && ok;
     }
+    return ok;
+}
 
-    gpiod_line* line = gpiod_chip_get_line(chip_, pin);
-    if (!line) {
-        std::cerr << "Failed to get line for GPIO " << pin << "\n";
+bool GPIO_Manager::set_debounce(int pin, uint32_t period_us) {
+    if (!valid_(pin)) {
+        logging::warn(logging::Module::kGpio, "Invalid debounce request for GPIO {}", pin);
         return false;
     }
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    std::lock_guard<std::mutex> output_lock(output_mutex_);
+    lines_[pin].debounce_us = period_us;
+    if (lines_[pin].direction != GPIO_Direction::kInput) {
+        return true; // applied when the pin becomes an input
+    }
+    return reconfigure_inputs_();
+}
+
+bool GPIO_Manager::set_event_clock(GPIO_EventClock clock) {
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    std::lock_guard<std::mutex> output_lock(output_mutex_);
+    if (clock == clock_) {
+        return true;
+    }
+    clock_ = clock;
+    return reconfigure_inputs_();
+}
 
-    int result;
-    if (direction == "out") {
-        result = gpiod_line_request_output(line, "GpioControl", 0);
-        std::cout << "Set GPIO " << pin << " as output\n";
-    } else if (direction == "in") {
-        result = gpiod_line_request_input(line, "GpioControl");
-        std::cout << "Set GPIO " << pin << " as input\n";
-    } else {
-        std::cerr << "Invalid direction for GPIO " << pin << ": " << direction << "\n";
+bool GPIO_Manager::set_counter(int pin, const GPIO_CounterConfig& config) {
+    if (!valid_(pin)) {
+        logging::warn(logging::Module::kGpio, "Invalid counter request for GPIO {}", pin);
+        return false;
+    }
+    if (lines_[pin].direction != GPIO_Direction::kInput &&
+        !set_direction(pin, GPIO_Direction::kInput)) {
         return false;
     }
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    lines_[pin].counter.configure(config);
+    lines_[pin].counting = true;
+    return true;
+}
 
-    if (result < 0) {
-        std::cerr << "Failed to set direction for GPIO " << pin << "\n";
+bool GPIO_Manager::clear_counter(int pin) {
+    if (!is_counter(pin)) {
         return false;
     }
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    lines_[pin].counting = false;
+    return true;
+}
 
-    pins_[pin] = {line, direction};
+bool GPIO_Manager::reset_counter(int pin) {
+    if (!is_counter(pin)) {
+        logging::warn(logging::Module::kGpio, "Pin {} not configured as counter", pin);
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    lines_[pin].counter.reset();
     return true;
 }
 
+std::vector<GPIO_CounterReading> GPIO_Manager::read_counters() const {
+    timespec ts{};
+    clock_gettime(clock_ == GPIO_EventClock::kRealtime ? CLOCK_REALTIME : CLOCK_MONOTONIC, &ts);
+    uint64_t now_ns = static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+
+    std::vector<GPIO_CounterReading> readings;
+    for (int pin = 0; pin < kMaxLines; pin++) {
+        if (lines_[pin].counting) {
+            readings.push_back(lines_[pin].counter.reading(pin, now_ns));
+        }
+    }
+    return readings;
+}
+
+GPIO_Direction GPIO_Manager::direction(int pin) const {
+    return valid_(pin) ? lines_[pin].direction.load() : GPIO_Direction::kUnused;
+}
+
 bool GPIO_Manager::write(int pin, int value) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    if (!pins_.count(pin) || pins_[pin].direction != "out") {
-        std::cerr << "Pin " << pin << " not configured as output\n";
+    if (!valid_(pin) || lines_[pin].direction != GPIO_Direction::kOutput) {
+        logging::warn(logging::Module::kGpio, "Pin {} not configured as output", pin);
         return false;
     }
-    bool success = gpiod_line_set_value(pins_[pin].line, value) == 0;
-    if (!success) {
-        std::cerr << "Failed to write to GPIO " << pin << "\n";
+    std::lock_guard<std::mutex> lock(output_mutex_);
+    lines_[pin].value = value ? 1 : 0;
+    return flush_outputs_();
+}
+
+bool GPIO_Manager::write_many(const std::map<int, int>& values) {
+    for (const auto& [pin, value] : values) {
+        if (!valid_(pin) || lines_[pin].direction != GPIO_Direction::kOutput) {
+            logging::warn(logging::Module::kGpio, "Pin {} not configured as output", pin);
+            return false;
+        }
+    }
+    std::lock_guard<std::mutex> lock(output_mutex_);
+    for (const auto& [pin, value] : values) {
+        lines_[pin].value = value ? 1 : 0;
+    }
+    return flush_outputs_();
+}
+
+bool GPIO_Manager::flush_outputs_() {
+    // the whole output group is set by one ioctl, so the changed pins switch
+    // together and the others are rewritten with their current level
+    int levels[kMaxLines];
+    for (size_t i = 0; i < output_pins_.size(); i++) {
+        levels[i] = lines_[output_pins_[i]].value;
+    }
+    if (!backend_->set_outputs(levels)) {
+        logging::error(logging::Module::kGpio, "Failed to write GPIO outputs");
         return false;
     }
-    std::cout << "Wrote " << value << " to GPIO " << pin << "\n";
-    return success;
+    return true;
 }
 
 bool GPIO_Manager::read(int pin, int& value) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    if (!pins_.count(pin) || pins_[pin].direction != "in") {
-        std::cerr << "Pin " << pin << " not configured as input\n";
+    if (!valid_(pin) || lines_[pin].direction != GPIO_Direction::kInput) {
+        logging::warn(logging::Module::kGpio, "Pin {} not configured as input", pin);
         return false;
     }
-    int val = gpiod_line_get_value(pins_[pin].line);
-    if (val < 0) {
-        std::cerr << "Failed to read GPIO " << pin << "\n";
-        return false;
+    if (!monitoring_) {
+        // no edge tracking yet, go to the line
+        std::lock_guard<std::mutex> lock(config_mutex_);
+        int levels[kMaxLines];
+        if (!backend_->get_inputs(levels)) {
+            logging::warn(logging::Module::kGpio, "Failed to read GPIO {}", pin);
+            return false;
+        }
+        for (size_t i = 0; i < input_pins_.size(); i++) {
+            lines_[input_pins_[i]].value = levels[i];
+        }
     }
-    value = val;
-    std::cout << "Read GPIO " << pin << ": " << value << "\n";
+    value = lines_[pin].value;
     return true;
 }
 
 std::vector<int> GPIO_Manager::get_input_pins() {
-    std::lock_guard<std::mutex> lock(mutex_);
-    std::vector<int> result;
-    for (const auto& [pin, info] : pins_) {
-        if (info.direction == "in") result.push_back(pin);
-    }
-    return result;
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    return input_pins_;
 }
+
 std::map<int, int> GPIO_Manager::read_all_inputs() {
     std::map<int, int> result;
-    std::lock_guard<std::mutex> lock(mutex_);
-    for (const auto& [pin, info] : pins_) {
-        if (info.direction == "in") {
-            int val = gpiod_line_get_value(info.line);
-            if (val < 0) {
-                std::cerr << "Failed to read GPIO " << pin << "\n";
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    for (int pin : input_pins_) {
+        result[pin] = lines_[pin].value;
+    }
+    return result;
+}
+
+// config_mutex_ and output_mutex_ held
+void GPIO_Manager::release_(bool outputs, bool inputs) {
+    if (outputs) {
+        backend_->release_outputs();
+        output_pins_.clear();
+    }
+    if (inputs) {
+        for (int fd : watched_fds_) {
+            unwatch_(fd);
+        }
+        watched_fds_.clear();
+        backend_->release_inputs();
+        input_pins_.clear();
+    }
+}
+
+// config_mutex_ and output_mutex_ held. Requests the given groups from the
+// line table; a group that fails is marked unused.
+bool GPIO_Manager::request_(bool outputs, bool inputs) {
+    bool ok = true;
+    if (outputs) {
+        std::vector<GPIO_LineConfig> lines;
+        for (int pin = 0; pin < kMaxLines; pin++) {
+            if (lines_[pin].direction == GPIO_Direction::kOutput) {
+                lines.push_back({pin, lines_[pin].value, 0});
+                output_pins_.push_back(pin);
+            }
+        }
+        if (!backend_->request_outputs(lines)) {
+            logging::error(logging::Module::kGpio, "Failed to request GPIO outputs");
+            for (int pin : output_pins_) lines_[pin].direction = GPIO_Direction::kUnused;
+            output_pins_.clear();
+            ok = false;
+        }
+    }
+    if (inputs) {
+        ok = request_inputs_() && ok;
+    }
+    return ok;
+}
+
+// config_mutex_ held. New debounce periods or clock for the current inputs;
+// the outputs are not touched.
+bool GPIO_Manager::reconfigure_inputs_() {
+    if (input_pins_.empty()) {
+        return true;
+    }
+    std::vector<GPIO_LineConfig> inputs;
+    for (int pin : input_pins_) {
+        inputs.push_back({pin, 0, lines_[pin].debounce_us});
+    }
+    for (int fd : watched_fds_) {
+        unwatch_(fd);
+    }
+    bool ok = backend_->reconfigure_inputs(inputs, clock_);
+    if (!ok) {
+        logging::error(logging::Module::kGpio, "Failed to reconfigure GPIO inputs");
+        watched_fds_.clear();
+        release_(false, true);
+        return request_(false, true);
+    }
+    // a backend that had to re-request may hand out new fds
+    watched_fds_ = backend_->event_fds();
+    for (int fd : watched_fds_) {
+        watch_(fd);
+    }
+    return true;
+}
+
+bool GPIO_Manager::request_inputs_() {
+    std::vector<GPIO_LineConfig> inputs;
+    for (int pin = 0; pin < kMaxLines; pin++) {
+        if (lines_[pin].direction == GPIO_Direction::kInput) {
+            inputs.push_back({pin, 0, lines_[pin].debounce_us});
+            input_pins_.push_back(pin);
+        }
+    }
+
+    bool ok = true;
+    // both-edge events; the lines can still be read in bulk
+    if (!backend_->request_inputs(inputs, clock_)) {
+        logging::error(logging::Module::kGpio, "Failed to request GPIO inputs");
+        for (int pin : input_pins_) lines_[pin].direction = GPIO_Direction::kUnused;
+        input_pins_.clear();
+        ok = false;
+    }
+    if (!input_pins_.empty()) {
+        // seed the tracked levels; edges keep them current from here on
+        int current[kMaxLines];
+        if (backend_->get_inputs(current)) {
+            for (size_t i = 0; i < input_pins_.size(); i++) {
+                lines_[input_pins_[i]].value = current[i];
+            }
+        }
+    }
+    watched_fds_ = backend_->event_fds();
+    for (int fd : watched_fds_) {
+        watch_(fd);
+    }
+    return ok;
+}
+
+void GPIO_Manager::start_event_monitor(EventCallback callback) {
+    if (monitoring_.exchange(true)) {
+        return;
+    }
+    callback_ = std::move(callback);
+    monitor_ = std::thread(&GPIO_Manager::monitor_loop_, this);
+}
+
+void GPIO_Manager::stop_event_monitor() {
+    if (!monitoring_.exchange(false)) {
+        return;
+    }
+    uint64_t one = 1;
+    if (::write(wake_fd_, &one, sizeof(one)) < 0) {
+        logging::warn(logging::Module::kGpio, "Failed to wake GPIO event monitor");
+    }
+    if (monitor_.joinable()) {
+        monitor_.join();
+    }
+}
+
+void GPIO_Manager::watch_(int fd) {
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = static_cast<uint64_t>(fd);
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        logging::warn(logging::Module::kGpio, "Failed to watch GPIO event fd {}", fd);
+    }
+}
+
+void GPIO_Manager::unwatch_(int fd) {
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+void GPIO_Manager::monitor_loop_() {
+    epoll_event ready[16];
+    GPIO_Event events[kMaxEventsPerRead];
+
+    while (monitoring_) {
+        int n = epoll_wait(epoll_fd_, ready, 16, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            logging::error(logging::Module::kGpio, "GPIO event monitor failed: errno {}", errno);
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            if (ready[i].data.u64 == kWakeToken) {
+                uint64_t drained;
+                while (::read(wake_fd_, &drained, sizeof(drained)) > 0) {
+                }
                 continue;
             }
-            result[pin] = val;
+
+            int fd = static_cast<int>(ready[i].data.u64);
+            int reported = 0;
+            {
+                // the lines may have been re-requested since epoll_wait; a
+                // stale fd is no longer known to the backend and reads nothing
+                std::lock_guard<std::mutex> lock(config_mutex_);
+                int count = backend_->read_events(fd, events, kMaxEventsPerRead);
+                for (int e = 0; e < count; e++) {
+                    const GPIO_Event& event = events[e];
+                    if (!valid_(event.pin) ||
+                        lines_[event.pin].direction != GPIO_Direction::kInput) {
+                        continue;
+                    }
+                    Line& line = lines_[event.pin];
+                    line.value = event.value;
+                    if (line.counting) {
+                        // pulse trains are counted here, not reported per edge
+                        if (line.counter.counts(event.value)) {
+                            line.counter.on_edge(event.timestamp_ns);
+                        }
+                        continue;
+                    }
+                    events[reported++] = event;
+                }
+            }
+            for (int e = 0; e < reported; e++) {
+                callback_(events[e]);
+            }
         }
     }
-    return result;
 }
@@ -1,34 +1,111 @@
 #pragma once
 
-#include <gpiod.h>
-#include <iostream>
-#include <stdexcept>
+#include "gpio_backend.hpp"
+#include "gpio_counter.hpp"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <map>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 class GPIO_Manager {
-    // This class is a wrapper for GPIO operations using the gpiod library.
+    // This class is a wrapper for GPIO operations using the gpiod library
+    // (v1 or v2, see GPIO_Backend).
     // It provides methods to set pin direction, read and write pin values,
     // and manage multiple GPIO pins in a thread-safe manner.
+    //
+    // Lines live in a flat table indexed by offset. Reads of configured pins
+    // are served from per-line atomics kept current by the edge monitor, and
+    // writes only serialize with other output writes, which share one ioctl.
 public:
+    static constexpr int kMaxLines = 64;
+
     GPIO_Manager(const std::string& chipname = "/dev/gpiochip0");
+    // Drives an already-opened chip, real or simulated (see hal.hpp)
+    explicit GPIO_Manager(std::unique_ptr<GPIO_Backend> backend);
     ~GPIO_Manager();
 
-    bool set_direction(int pin, const std::string& direction);
+    bool set_direction(int pin, GPIO_Direction direction);
+    // Sets up every line, with its debounce period and the event clock, in
+    // one go instead of re-requesting per pin. Lines in neither list are
+    // released. Only a group whose lines change is re-requested, so the
+    // untouched outputs keep driving and no input edge is lost; debounce or
+    // clock changes alone reconfigure the inputs in place.
+    bool configure(const std::vector<int>& outputs, const std::vector<int>& inputs,
+                   const std::map<int, uint32_t>& debounce_us, GPIO_EventClock clock);
     bool write(int pin, int value);
+    // All outputs are one bulk request: the given pins change together in a
+    // single ioctl
+    bool write_many(const std::map<int, int>& values);
     bool read(int pin, int& value);
+    GPIO_Direction direction(int pin) const;
     std::vector<int> get_input_pins();
     std::map<int, int> read_all_inputs();
 
+    // Kernel debounce period for an input. v2 changes the live input request
+    // in place; v1 has no debounce (it logs and ignores it) and re-requests
+    // the inputs. Outputs are never touched.
+    bool set_debounce(int pin, uint32_t period_us);
+    // Clock used for event timestamps, for every input
+    bool set_event_clock(GPIO_EventClock clock);
+    bool supports_debounce() const { return backend_->supports_debounce(); }
+
+    // Counter mode: the pin becomes an input whose edges are counted in the
+    // monitor thread rather than passed to the event callback one by one.
+    // Counts, period and frequency are read lock-free.
+    bool set_counter(int pin, const GPIO_CounterConfig& config);
+    bool clear_counter(int pin);
+    bool reset_counter(int pin);
+    bool is_counter(int pin) const { return valid_(pin) && lines_[pin].counting; }
+    std::vector<GPIO_CounterReading> read_counters() const;
+
+    // Input lines are requested with both-edge events. The monitor thread
+    // waits on their fds and hands every edge to the callback as it is read
+    // from the kernel, in batches, so nothing between polls is lost.
+    using EventCallback = std::function<void(const GPIO_Event&)>;
+    void start_event_monitor(EventCallback callback);
+    void stop_event_monitor();
+
 private:
-    struct PinInfo {
-        gpiod_line* line = nullptr;
-        std::string direction;
+    void monitor_loop_();
+    void watch_(int fd);
+    void unwatch_(int fd);
+    // Releases / requests the output and input groups independently, so a
+    // change to one never leaves the other's lines unowned
+    void release_(bool outputs, bool inputs);
+    bool request_(bool outputs, bool inputs);
+    bool request_inputs_();
+    bool reconfigure_inputs_();
+    bool flush_outputs_();
+    static bool valid_(int pin) { return pin >= 0 && pin < kMaxLines; }
+
+    struct Line {
+        std::atomic<GPIO_Direction> direction{GPIO_Direction::kUnused};
+        // inputs: level after the last edge, outputs: last level written
+        std::atomic<int> value{0};
+        uint32_t debounce_us = 0;
+        std::atomic<bool> counting{false};
+        GPIO_Counter counter;
     };
 
-    gpiod_chip* chip_;
-    std::map<int, PinInfo> pins_;
-    std::mutex mutex_;
-};
\ No newline at end of file
+    std::unique_ptr<GPIO_Backend> backend_;
+    std::array<Line, kMaxLines> lines_;
+    std::mutex config_mutex_; // direction changes and event reads
+    std::mutex output_mutex_; // the shared output ioctl
+    std::atomic<GPIO_EventClock> clock_{GPIO_EventClock::kMonotonic};
+
+    // Pins in the order they were requested from the backend
+    std::vector<int> output_pins_;
+    std::vector<int> input_pins_;
+    std::vector<int> watched_fds_;
+
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1; // eventfd used to stop the monitor
+    EventCallback callback_;
+    std::atomic<bool> monitoring_{false};
+    std::thread monitor_;
+};
@@ -1,5 +1,6 @@
 
 #include "io_expander.hpp"
+#include "../logging/log.hpp"
 
 bool write_failed = false;
 
@@ -28,21 +29,22 @@ void TCA9535::configure_port(uint8_t port, uint8_t direction) {
 
 void TCA9535::write_output(std::bitset<16> state) {
     bool success = false;
-    std::cout << "Writing Relay States" << std::endl;
+    logging::debug(logging::Module::kRelay, "Writing relay states 0x{:x}", state.to_ulong());
 
     uint16_t value = static_cast<uint16_t>(state.to_ulong());
     write_register(OUTPUT_PORT0, value & 0xFF);
     write_register(OUTPUT_PORT1, (value >> 8) & 0xFF);
 
     if (write_failed) {
-        std::cerr << "Issue with writing relay state. Retrying..." << std::endl;
+        logging::warn(logging::Module::kRelay, "Issue with writing relay state. Retrying...");
         
         for (int retries = 0; retries < 10; retries++) {
             write_register(OUTPUT_PORT0, value & 0xFF);
             write_register(OUTPUT_PORT1, (value >> 8) & 0xFF);
 
             if (!write_failed) {
-                std::cout << "Relay state written successfully after retry." << std::endl;
+                logging::info(logging::Module::kRelay, "Relay state written successfully after {} retries",
+                              retries + 1);
                 success = true;
                 break;
             }
@@ -9,7 +9,9 @@
 #include <linux/i2c-dev.h>
 #include <iostream>
 
-class TCA9535 {
+#include "../hal/relay_expander.hpp"
+
+class TCA9535 : public RelayExpander {
   private:
     int i2c_fd;
     uint8_t device_address;
@@ -27,11 +29,11 @@ class TCA9535 {
 
   public:
     TCA9535(const char* i2c_bus, uint8_t address);
-    ~TCA9535();
+    ~TCA9535() override;
 
-    void configure_port(uint8_t port, uint8_t direction);
-    void write_output(std::bitset<16> state);
-    uint8_t read_input(uint8_t port);
+    void configure_port(uint8_t port, uint8_t direction) override;
+    void write_output(std::bitset<16> state) override;
+    uint8_t read_input(uint8_t port) override;
 
   private:
     void write_register(uint8_t reg, uint8_t value);
@@ -0,0 +1,149 @@
+#include "quadrature_encoder.hpp"
+#include "../logging/log.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace {
+constexpr uint64_t kWakeToken = UINT64_MAX;
+constexpr int kMaxEventsPerRead = 64;
+
+// count step for each (previous state << 2 | new state); states are
+// (A << 1) | B and go 00 -> 01 -> 11 -> 10 -> 00 in the positive direction.
+// An event moves one line, so the diagonal and both-bits entries are never
+// looked up.
+constexpr int8_t kTransition[16] = {
+    0,  +1, -1, 0, // from 00
+    -1, 0,  0, +1, // from 01
+    +1, 0,  0, -1, // from 10
+    0, -1, +1, 0,  // from 11
+};
+}
+
+QuadratureEncoder::QuadratureEncoder(const std::string& chipname,
+                                     const QuadratureConfig& config)
+    : QuadratureEncoder(make_gpio_backend(chipname), config) {}
+
+QuadratureEncoder::QuadratureEncoder(std::unique_ptr<GPIO_Backend> backend,
+                                     const QuadratureConfig& config)
+    : config_(config), backend_(std::move(backend)) {
+    if (config_.pin_a < 0 || config_.pin_b < 0 || config_.pin_a == config_.pin_b) {
+        throw std::runtime_error("Quadrature encoder needs two distinct pins");
+    }
+    std::vector<GPIO_LineConfig> lines = {{config_.pin_a, 0, config_.debounce_us},
+                                          {config_.pin_b, 0, config_.debounce_us}};
+    if (!backend_->request_inputs(lines, GPIO_EventClock::kMonotonic)) {
+        throw std::runtime_error("Failed to request encoder lines " +
+                                 std::to_string(config_.pin_a) + "/" +
+                                 std::to_string(config_.pin_b));
+    }
+    int levels[2] = {0, 0};
+    backend_->get_inputs(levels);
+    state_ = static_cast<uint8_t>((levels[0] ? 2 : 0) | (levels[1] ? 1 : 0));
+
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (epoll_fd_ < 0 || wake_fd_ < 0) {
+        if (epoll_fd_ >= 0) close(epoll_fd_);
+        if (wake_fd_ >= 0) close(wake_fd_);
+        throw std::runtime_error("Failed to set up encoder event polling");
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = kWakeToken;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev);
+    std::vector<int> fds = backend_->event_fds();
+    for (int fd : fds) {
+        ev.data.u64 = static_cast<uint64_t>(fd);
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev);
+    }
+    merge_ = fds.size() > 1;
+}
+
+QuadratureEncoder::~QuadratureEncoder() {
+    stop();
+    backend_->release();
+    close(epoll_fd_);
+    close(wake_fd_);
+}
+
+void QuadratureEncoder::start() {
+    if (running_.exchange(true)) {
+        return;
+    }
+    thread_ = std::thread(&QuadratureEncoder::run_, this);
+}
+
+void QuadratureEncoder::stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+    uint64_t one = 1;
+    if (::write(wake_fd_, &one, sizeof(one)) < 0) {
+        logging::warn(logging::Module::kGpio, "Failed to wake encoder thread");
+    }
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void QuadratureEncoder::apply_(const GPIO_Event& event) {
+    uint8_t bit = event.pin == config_.pin_a ? 2 : 1;
+    // An edge to the level the line already holds means this edge or the
+    // one before it on the same line was lost; which way the encoder moved
+    // in between can't be told
+    if (((state_ & bit) != 0) == (event.value != 0)) {
+        errors_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    uint8_t next = state_ ^ bit;
+
+    int8_t step = kTransition[(state_ << 2) | next];
+    state_ = next;
+    if (step) {
+        raw_.store(raw_.load(std::memory_order_relaxed) + (config_.invert ? -step : step),
+                   std::memory_order_relaxed);
+    }
+    last_ns_.store(event.timestamp_ns, std::memory_order_relaxed);
+}
+
+void QuadratureEncoder::run_() {
+    epoll_event ready[4];
+    GPIO_Event events[kMaxEventsPerRead * 2];
+
+    while (running_) {
+        int n = epoll_wait(epoll_fd_, ready, 4, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            logging::error(logging::Module::kGpio, "Encoder thread failed: errno {}", errno);
+            break;
+        }
+        int count = 0;
+        for (int i = 0; i < n; i++) {
+            if (ready[i].data.u64 == kWakeToken) {
+                uint64_t drained;
+                while (::read(wake_fd_, &drained, sizeof(drained)) > 0) {
+                }
+                continue;
+            }
+            int got = backend_->read_events(static_cast<int>(ready[i].data.u64),
+                                            events + count, kMaxEventsPerRead);
+            if (got > 0) count += got;
+        }
+        // v1 delivers each line on its own fd; put the edges of both back in
+        // the order they happened before decoding
+        if (merge_) {
+            std::stable_sort(events, events + count,
+                             [](const GPIO_Event& a, const GPIO_Event& b) {
+                                 return a.timestamp_ns < b.timestamp_ns;
+                             });
+        }
+        for (int e = 0; e < count; e++) {
+            apply_(events[e]);
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "gpio_backend.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+
+struct QuadratureConfig {
+    int pin_a = -1;
+    int pin_b = -1;
+    uint32_t debounce_us = 0; // kernel debounce on both lines (v2 backend)
+    double scale = 1.0;       // position units per count (4 counts per cycle)
+    bool invert = false;      // swap the counting direction
+};
+
+class QuadratureEncoder {
+    // x4 quadrature decoder on a pair of GPIO inputs.
+    //
+    // The pair is requested on its own, separately from GPIO_Manager, and a
+    // dedicated thread waits for their edge events and steps a state table.
+    // An edge that leaves its line at the level it already had can't be
+    // decoded (an edge was lost, or the encoder outran the debounce) and is
+    // counted as an error rather than guessed. Position and error count are single-writer
+    // atomics, so readers never block the decoder.
+public:
+    // Throws if the chip can't be opened or the lines can't be requested
+    QuadratureEncoder(const std::string& chipname, const QuadratureConfig& config);
+    QuadratureEncoder(std::unique_ptr<GPIO_Backend> backend, const QuadratureConfig& config);
+    ~QuadratureEncoder();
+
+    void start();
+    void stop();
+
+    int64_t count() const {
+        return raw_.load(std::memory_order_relaxed) - offset_.load(std::memory_order_relaxed);
+    }
+    double position() const { return static_cast<double>(count()) * config_.scale; }
+    uint64_t errors() const { return errors_.load(std::memory_order_relaxed); }
+    uint64_t last_edge_ns() const { return last_ns_.load(std::memory_order_relaxed); }
+    // Makes the current position read as `position` counts
+    void zero(int64_t position = 0) { offset_ = raw_.load() - position; }
+
+    const QuadratureConfig& config() const { return config_; }
+
+private:
+    void run_();
+    void apply_(const GPIO_Event& event);
+
+    QuadratureConfig config_;
+    std::unique_ptr<GPIO_Backend> backend_;
+    uint8_t state_ = 0; // (A << 1) | B, decoder thread only
+    bool merge_ = false; // lines arrive on separate fds (v1)
+
+    std::atomic<int64_t> raw_{0};
+    std::atomic<int64_t> offset_{0};
+    std::atomic<uint64_t> errors_{0};
+    std::atomic<uint64_t> last_ns_{0};
+
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+};
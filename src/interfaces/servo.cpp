@@ -9,29 +9,42 @@
  */
 
  #include "servo.hpp"
-
- #define ENABLE_DEBUG_OUTPUT // comment out to suppress debug level dumps
+ #include "../logging/log.hpp"
+ 
+ #include <algorithm>
+ #include <cstring>
  
  /*!
   *  @brief  Instantiates a new PCA9685 PWM driver chip with the I2C address
   *  @param  addr The 7-bit I2C address to locate this chip, default is 0x40
   */
  Adafruit_PWMServoDriver::Adafruit_PWMServoDriver(const uint8_t addr)
-     : _i2caddr(addr) {}
+     : fd(-1), _i2caddr(addr), _oscillator_freq(FREQUENCY_OSCILLATOR) {
+     // Power-on register defaults from the datasheet, until begin() loads the
+     // real contents with resync()
+     _regs[PCA9685_MODE1] = MODE1_SLEEP | MODE1_ALLCAL;
+     _regs[PCA9685_MODE2] = MODE2_OUTDRV;
+     _regs[PCA9685_PRESCALE] = 0x1E;
+     for (uint8_t i = 0; i < PCA9685_CHANNELS; i++) {
+         _regs[PCA9685_LED0_OFF_H + PCA9685_CHANNEL_REGS * i] = 0x10;
+     }
+ }
  
  /*!
   *  @brief  Setups the I2C interface and hardware
   *  @param  prescale
   *          Sets External Clock (Optional)
+  *  @return true if the I2C device could be opened
   */
- void Adafruit_PWMServoDriver::begin(uint8_t prescale) {
+ bool Adafruit_PWMServoDriver::begin(uint8_t prescale) {
+     std::lock_guard<std::recursive_mutex> lock(_bus_lock);
      this->fd = wiringPiI2CSetup(_i2caddr);
      if (this->fd < 0) {
-         std::cerr << "Failed to initialize I2C communication." << std::endl;
-         return;
+         logging::error(logging::Module::kServo, "Failed to initialize I2C communication at 0x{:x}", _i2caddr);
+         return false;
      }
      else {
-         std::cout << "I2C communication initialized successfully." << std::endl;
+         logging::info(logging::Module::kServo, "I2C communication initialized successfully at 0x{:x}", _i2caddr);
      }
      reset();
      if (prescale) {
@@ -42,12 +55,17 @@
      }
      // set the default internal frequency
      setOscillatorFrequency(FREQUENCY_OSCILLATOR);
+     // reset() cleared MODE1_AI and the clock setup above set it again, so
+     // the LEDn registers can now be read back as one block
+     resync();
+     return true;
  }
  
  /*!
   *  @brief  Sends a reset command to the PCA9685 chip over I2C
   */
  void Adafruit_PWMServoDriver::reset() {
+     std::lock_guard<std::recursive_mutex> lock(_bus_lock);
      write8(PCA9685_MODE1, MODE1_RESTART);
      delay(10);
  }
@@ -56,7 +74,8 @@
   *  @brief  Puts board into sleep mode
   */
  void Adafruit_PWMServoDriver::sleep() {
-     uint8_t awake = read8(PCA9685_MODE1);
+     std::lock_guard<std::recursive_mutex> lock(_bus_lock);
+     uint8_t awake = _regs[PCA9685_MODE1];
      uint8_t sleep = awake | MODE1_SLEEP; // set sleep bit high
      write8(PCA9685_MODE1, sleep);
      delay(5); // wait until cycle ends for sleep to be active
@@ -66,7 +85,8 @@
   *  @brief  Wakes board from sleep
   */
  void Adafruit_PWMServoDriver::wakeup() {
-     uint8_t sleep = read8(PCA9685_MODE1);
+     std::lock_guard<std::recursive_mutex> lock(_bus_lock);
+     uint8_t sleep = _regs[PCA9685_MODE1];
      uint8_t wakeup = sleep & ~MODE1_SLEEP; // set sleep bit low
      write8(PCA9685_MODE1, wakeup);
  }
@@ -77,7 +97,8 @@
   *          Configures the prescale value to be used by the external clock
   */
  void Adafruit_PWMServoDriver::setExtClk(uint8_t prescale) {
-     uint8_t oldmode = read8(PCA9685_MODE1);
+     std::lock_guard<std::recursive_mutex> lock(_bus_lock);
+     uint8_t oldmode = _regs[PCA9685_MODE1];
      uint8_t newmode = (oldmode & ~MODE1_RESTART) | MODE1_SLEEP; // sleep
      write8(PCA9685_MODE1, newmode); // go to sleep, turn off internal oscillator
  
@@ -91,10 +112,7 @@
      // clear the SLEEP bit to start
      write8(PCA9685_MODE1, (newmode & ~MODE1_SLEEP) | MODE1_RESTART | MODE1_AI);
  
- #ifdef ENABLE_DEBUG_OUTPUT
-     std::cout << "Mode now 0x" << std::hex << read8(PCA9685_MODE1) << std::dec
-               << std::endl;
- #endif
+     logging::debug(logging::Module::kServo, "Mode now 0x{:x}", _regs[PCA9685_MODE1]);
  }
  
  /*!
@@ -102,9 +120,8 @@
   *  @param  freq Floating point frequency that we will attempt to match
   */
  void Adafruit_PWMServoDriver::setPWMFreq(float freq) {
- #ifdef ENABLE_DEBUG_OUTPUT
-     std::cout << "Attempting to set freq " << freq << std::endl;
- #endif
+     std::lock_guard<std::recursive_mutex> lock(_bus_lock);
+     logging::debug(logging::Module::kServo, "Attempting to set freq {}", freq);
      // Range output modulation frequency is dependant on oscillator
      if (freq < 1)
          freq = 1;
@@ -118,11 +135,9 @@
          prescaleval = PCA9685_PRESCALE_MAX;
      uint8_t prescale = (uint8_t)prescaleval;
  
- #ifdef ENABLE_DEBUG_OUTPUT
-     std::cout << "Final pre-scale: " << prescale << std::endl;
- #endif
+     logging::debug(logging::Module::kServo, "Final pre-scale: {}", prescale);
  
-     uint8_t oldmode = read8(PCA9685_MODE1);
+     uint8_t oldmode = _regs[PCA9685_MODE1];
      uint8_t newmode = (oldmode & ~MODE1_RESTART) | MODE1_SLEEP; // sleep
      write8(PCA9685_MODE1, newmode);                             // go to sleep
      write8(PCA9685_PRESCALE, prescale); // set the prescaler
@@ -131,10 +146,7 @@
      // This sets the MODE1 register to turn on auto increment.
      write8(PCA9685_MODE1, oldmode | MODE1_RESTART | MODE1_AI);
  
- #ifdef ENABLE_DEBUG_OUTPUT
-     std::cout << "Mode now 0x" << std::hex << read8(PCA9685_MODE1) << std::dec
-               << std::endl;
- #endif
+     logging::debug(logging::Module::kServo, "Mode now 0x{:x}", _regs[PCA9685_MODE1]);
  }
  
  /*!
@@ -145,7 +157,8 @@
   *  @param  totempole Totempole if true, open drain if false.
   */
  void Adafruit_PWMServoDriver::setOutputMode(bool totempole) {
-     uint8_t oldmode = read8(PCA9685_MODE2);
+     std::lock_guard<std::recursive_mutex> lock(_bus_lock);
+     uint8_t oldmode = _regs[PCA9685_MODE2];
      uint8_t newmode;
      if (totempole) {
          newmode = oldmode | MODE2_OUTDRV;
@@ -153,34 +166,62 @@
          newmode = oldmode & ~MODE2_OUTDRV;
      }
      write8(PCA9685_MODE2, newmode);
- #ifdef ENABLE_DEBUG_OUTPUT
-     if (totempole) {
-         std::cout << "Setting output mode: totempole";
-     } else {
-         std::cout << "Setting output mode: open drain";
-     }
-     std::cout << " by setting MODE2 to " << newmode << std::endl;
- #endif
+     logging::debug(logging::Module::kServo, "Setting output mode: {} by setting MODE2 to {}",
+                    totempole ? "totempole" : "open drain", newmode);
  }
  
  /*!
-  *  @brief  Reads set Prescale from PCA9685
+  *  @brief  Reads set Prescale from the register shadow, no bus traffic
   *  @return prescale value
   */
  uint8_t Adafruit_PWMServoDriver::readPrescale(void) {
-     return read8(PCA9685_PRESCALE);
+     return _regs[PCA9685_PRESCALE];
  }
  
  /*!
-  *  @brief  Gets the PWM duty cycle of one of the PCA9685 pins
+  *  @brief  Reads MODE1, MODE2, PRESCALE and every LEDn register back from the
+  * chip and compares them against the shadow, which is then reloaded from the
+  * hardware values. The LEDn block read needs MODE1_AI; if the chip lost it
+  * (a reset, a brown-out) it is set again first, and the shadow is reported
+  * out of sync.
+  *  @return true if the shadow matched the hardware
+  */
+ bool Adafruit_PWMServoDriver::resync() {
+     std::lock_guard<std::recursive_mutex> lock(_bus_lock);
+     uint8_t hw[PCA9685_CHANNELS * PCA9685_CHANNEL_REGS];
+     uint8_t mode1 = read8(PCA9685_MODE1) & ~MODE1_RESTART;
+     uint8_t mode2 = read8(PCA9685_MODE2);
+     uint8_t prescale = read8(PCA9685_PRESCALE);
+     bool had_ai = mode1 & MODE1_AI;
+     if (!had_ai) {
+         mode1 |= MODE1_AI;
+         write8(PCA9685_MODE1, mode1);
+     }
+     readBlock(PCA9685_LED0_ON_L, hw, sizeof(hw));
+ 
+     bool in_sync = had_ai && mode1 == _regs[PCA9685_MODE1] &&
+                    mode2 == _regs[PCA9685_MODE2] &&
+                    prescale == _regs[PCA9685_PRESCALE] &&
+                    std::memcmp(hw, _regs + PCA9685_LED0_ON_L, sizeof(hw)) == 0;
+ 
+     _regs[PCA9685_MODE1] = mode1;
+     _regs[PCA9685_MODE2] = mode2;
+     _regs[PCA9685_PRESCALE] = prescale;
+     std::memcpy(_regs + PCA9685_LED0_ON_L, hw, sizeof(hw));
+     return in_sync;
+ }
+ 
+ /*!
+  *  @brief  Gets the PWM duty cycle of one of the PCA9685 pins from the
+  * register shadow
   *  @param  num One of the PWM output pins, from 0 to 15
   *  @return returns a duty cycle between 0 and 4096
   */
  uint16_t Adafruit_PWMServoDriver::getPWM(uint8_t num) {
-     uint8_t channel_base_reg = PCA9685_LED0_ON_L + 4 * num;
-     uint16_t on = (read8(channel_base_reg + 1) << 8) + read8(channel_base_reg);
-     uint16_t off =
-         (read8(channel_base_reg + 3) << 8) + read8(channel_base_reg + 2);
+     std::lock_guard<std::recursive_mutex> lock(_bus_lock);
+     const uint8_t* regs = _regs + PCA9685_LED0_ON_L + 4 * num;
+     uint16_t on = (regs[1] << 8) + regs[0];
+     uint16_t off = (regs[3] << 8) + regs[2];
  
      if (off < on)
          return 4096 + off - on;
@@ -195,19 +236,87 @@
   *  @param  off At what point in the 4096-part cycle to turn the PWM output OFF
   */
  void Adafruit_PWMServoDriver::setPWM(uint8_t num, uint16_t on, uint16_t off) {
- #ifdef ENABLE_DEBUG_OUTPUT
-     std::cout << "Setting PWM " << num << ": " << on << "->" << off
-               << std::endl;
- #endif
-     uint8_t channel_base_reg = PCA9685_LED0_ON_L + 4 * num;
-     write8(channel_base_reg,
-            (uint8_t)(on & 0xFF)); // write least significant 8 bits of ON
-     write8(channel_base_reg + 1,
-            on >> 8); // write most significant 8 bits of ON
-     write8(channel_base_reg + 2,
-            (uint8_t)(off & 0xFF)); // write least significant 8 bits of OFF
-     write8(channel_base_reg + 3,
-            off >> 8); // write most significant 8 bits of OFF
+     logging::debug(logging::Module::kServo, "Setting PWM {}: {}->{}", num, on, off);
+     setMultiplePWM(num, 1, &on, &off);
+ }
+ 
+ /*!
+  *  @brief  Sets the PWM output of a contiguous range of PCA9685 pins in a
+  * single I2C transaction. Relies on MODE1_AI, which begin() always enables,
+  * so the LEDn_ON/OFF registers of every channel in the range are written by
+  * one block transfer.
+  *  @param  first The first PWM output pin of the range, from 0 to 15
+  *  @param  count Number of consecutive pins to update
+  *  @param  on ON tick for each pin in the range, count entries
+  *  @param  off OFF tick for each pin in the range, count entries
+  */
+ void Adafruit_PWMServoDriver::setMultiplePWM(uint8_t first, uint8_t count,
+                                              const uint16_t* on,
+                                              const uint16_t* off) {
+     if (first >= PCA9685_CHANNELS || count == 0) {
+         return;
+     }
+     count = std::min<uint8_t>(count, PCA9685_CHANNELS - first);
+     std::lock_guard<std::recursive_mutex> lock(_bus_lock);
+ 
+     uint8_t data[PCA9685_CHANNELS * PCA9685_CHANNEL_REGS];
+     for (uint8_t i = 0; i < count; i++) {
+         uint8_t* regs = data + i * PCA9685_CHANNEL_REGS;
+         regs[0] = (uint8_t)(on[i] & 0xFF); // least significant 8 bits of ON
+         regs[1] = on[i] >> 8;              // most significant 8 bits of ON
+         regs[2] = (uint8_t)(off[i] & 0xFF); // least significant 8 bits of OFF
+         regs[3] = off[i] >> 8;              // most significant 8 bits of OFF
+     }
+     writeBlock(PCA9685_LED0_ON_L + PCA9685_CHANNEL_REGS * first, data,
+                count * PCA9685_CHANNEL_REGS);
+ }
+ 
+ /*!
+  *  @brief  Sets the PWM output of an arbitrary set of PCA9685 pins in a
+  * single I2C transaction. The block spans the lowest to the highest selected
+  * pin; pins in between that are not selected are rewritten with their
+  * shadowed values.
+  *  @param  mask Bit n selects pin n
+  *  @param  on ON tick for each of the 16 pins, indexed by pin
+  *  @param  off OFF tick for each of the 16 pins, indexed by pin
+  */
+ void Adafruit_PWMServoDriver::setPWMChannels(uint16_t mask, const uint16_t* on,
+                                              const uint16_t* off) {
+     if (mask == 0) {
+         return;
+     }
+     std::lock_guard<std::recursive_mutex> lock(_bus_lock);
+     uint8_t first = __builtin_ctz(mask);
+     uint8_t last = 31 - __builtin_clz(mask);
+ 
+     uint16_t range_on[PCA9685_CHANNELS];
+     uint16_t range_off[PCA9685_CHANNELS];
+     for (uint8_t num = first; num <= last; num++) {
+         if (mask & (1u << num)) {
+             range_on[num - first] = on[num];
+             range_off[num - first] = off[num];
+         } else {
+             const uint8_t* regs = _regs + PCA9685_LED0_ON_L + 4 * num;
+             range_on[num - first] = (regs[1] << 8) + regs[0];
+             range_off[num - first] = (regs[3] << 8) + regs[2];
+         }
+     }
+     setMultiplePWM(first, last - first + 1, range_on, range_off);
+ }
+ 
+ /*!
+  *  @brief  Sets the PWM output of all 16 PCA9685 pins to the same value with
+  * one write to the ALLLED registers
+  *  @param  on At what point in the 4096-part cycle to turn the PWM outputs ON
+  *  @param  off At what point in the 4096-part cycle to turn the PWM outputs
+  * OFF
+  */
+ void Adafruit_PWMServoDriver::setAllPWM(uint16_t on, uint16_t off) {
+     uint8_t data[PCA9685_CHANNEL_REGS] = {
+         (uint8_t)(on & 0xFF), (uint8_t)(on >> 8), (uint8_t)(off & 0xFF),
+         (uint8_t)(off >> 8)};
+     std::lock_guard<std::recursive_mutex> lock(_bus_lock);
+     writeBlock(PCA9685_ALLLED_ON_L, data, sizeof(data));
  }
  
  /*!
@@ -254,21 +363,17 @@
   */
  void Adafruit_PWMServoDriver::writeMicroseconds(uint8_t num,
                                                  uint16_t Microseconds) {
- #ifdef ENABLE_DEBUG_OUTPUT
-     std::cout << "Setting PWM Via Microseconds on output " << num << ": "
-               << Microseconds << std::endl;
- #endif
+     logging::debug(logging::Module::kServo, "Setting PWM Via Microseconds on output {}: {}",
+                    num, Microseconds);
  
      double pulse = Microseconds;
      double pulselength;
      pulselength = 1000000; // 1,000,000 us per second
  
-     // Read prescale
+     // Prescale comes from the shadow, so the only bus traffic is setPWM
      uint16_t prescale = readPrescale();
  
- #ifdef ENABLE_DEBUG_OUTPUT
-     std::cout << prescale << " PCA9685 chip prescale" << std::endl;
- #endif
+     logging::debug(logging::Module::kServo, "{} PCA9685 chip prescale", prescale);
  
      // Calculate the pulse for PWM based on Equation 1 from the datasheet
      // section 7.3.5
@@ -276,19 +381,24 @@
      pulselength *= prescale;
      pulselength /= _oscillator_freq;
  
- #ifdef ENABLE_DEBUG_OUTPUT
-     std::cout << pulselength << " us per bit" << std::endl;
- #endif
+     logging::debug(logging::Module::kServo, "{} us per bit", pulselength);
  
      pulse /= pulselength;
  
- #ifdef ENABLE_DEBUG_OUTPUT
-     std::cout << pulse << " pulse for PWM" << std::endl;
- #endif
+     logging::debug(logging::Module::kServo, "{} pulse for PWM", pulse);
  
      setPWM(num, 0, pulse);
  }
  
+ /*!
+  *  @brief  Gets the PWM frame rate the chip is running at, from the shadowed
+  * prescale and the tracked oscillator frequency
+  *  @return PWM frequency in Hz
+  */
+ float Adafruit_PWMServoDriver::getPWMFreq() {
+     return (float)_oscillator_freq / (4096.0f * (readPrescale() + 1));
+ }
+ 
  /*!
   *  @brief  Getter for the internally tracked oscillator used for freq
   * calculations
@@ -313,8 +423,61 @@
      return wiringPiI2CReadReg8(this->fd, addr);
  }
  
+ /*!
+  *  @brief Reads consecutive registers starting at addr. Used by resync() only.
+  *  @param addr First register to read
+  *  @param data Destination for the register values
+  *  @param len Number of registers to read
+  */
+ void Adafruit_PWMServoDriver::readBlock(uint8_t addr, uint8_t* data,
+                                         size_t len) {
+     if (::write(this->fd, &addr, 1) != 1 ||
+         ::read(this->fd, data, len) != (ssize_t)len) {
+         // fall back to register-at-a-time reads
+         for (size_t i = 0; i < len; i++) {
+             data[i] = read8(addr + i);
+         }
+     }
+ }
+ 
+ /*!
+  *  @brief Writes one register and mirrors it into the shadow. RESTART is a
+  * one-shot command bit, so it is never kept in the MODE1 shadow.
+  */
  void Adafruit_PWMServoDriver::write8(uint8_t addr, uint8_t d) {
      wiringPiI2CWriteReg8(this->fd, addr, d);
+     _regs[addr] = addr == PCA9685_MODE1 ? d & ~MODE1_RESTART : d;
+ }
+ 
+ /*!
+  *  @brief Writes consecutive registers starting at addr in one I2C transfer.
+  * The wiringPi fd is a plain i2c-dev handle with the slave address already
+  * selected, so the register address and payload go out as a single write.
+  *  @param addr First register to write
+  *  @param data Register values
+  *  @param len Number of registers to write, at most 64
+  */
+ void Adafruit_PWMServoDriver::writeBlock(uint8_t addr, const uint8_t* data,
+                                          size_t len) {
+     uint8_t buffer[1 + PCA9685_CHANNELS * PCA9685_CHANNEL_REGS];
+     len = std::min(len, sizeof(buffer) - 1);
+     buffer[0] = addr;
+     std::memcpy(buffer + 1, data, len);
+     if (::write(this->fd, buffer, len + 1) != (ssize_t)(len + 1)) {
+         logging::error(logging::Module::kServo, "PCA9685 0x{:x} block write to register 0x{:x} failed",
+                        _i2caddr, addr);
+     }
+ 
+     // mirror into the shadow, fanning ALLLED writes out to every channel
+     if (addr == PCA9685_ALLLED_ON_L) {
+         for (uint8_t i = 0; i < PCA9685_CHANNELS; i++) {
+             std::memcpy(_regs + PCA9685_LED0_ON_L + PCA9685_CHANNEL_REGS * i,
+                         buffer + 1, std::min<size_t>(len, PCA9685_CHANNEL_REGS));
+         }
+     } else {
+         std::memcpy(_regs + addr, buffer + 1,
+                     std::min<size_t>(len, sizeof(_regs) - addr));
+     }
  }
  
  /*!
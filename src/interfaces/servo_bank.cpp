@@ -0,0 +1,101 @@
+#include "servo_bank.hpp"
+#include "../logging/log.hpp"
+
+#include <algorithm>
+#include <future>
+
+size_t ServoBank::begin(const std::vector<ServoBoardConfig>& boards,
+                        const DriverFactory& make_driver) {
+    boards_.clear();
+    ready_.clear();
+    mappings_.clear();
+
+    // reset() and setPWMFreq() each sleep for several ms, so overlapping the
+    // boards keeps startup at the cost of one
+    std::vector<std::future<bool>> pending;
+    for (const auto& config : boards) {
+        boards_.push_back(make_driver(config.address));
+        PwmDriver* driver = boards_.back().get();
+        pending.push_back(std::async(std::launch::async, [driver, config] {
+            if (!driver->begin()) {
+                return false;
+            }
+            driver->setOscillatorFrequency(config.oscillator_hz);
+            driver->setPWMFreq(config.pwm_freq);
+            return true;
+        }));
+    }
+
+    size_t ready = 0;
+    for (size_t i = 0; i < pending.size(); i++) {
+        ready_.push_back(pending[i].get());
+        if (ready_.back()) {
+            ready++;
+        } else {
+            logging::error(logging::Module::kServo, "PCA9685 at 0x{:x} failed to initialize, servos {}-{} unavailable",
+                           boards[i].address, i * PCA9685_CHANNELS, (i + 1) * PCA9685_CHANNELS - 1);
+        }
+    }
+
+    for (size_t b = 0; b < boards_.size(); b++) {
+        for (uint8_t ch = 0; ch < PCA9685_CHANNELS; ch++) {
+            mappings_.push_back({(uint8_t)b, ch});
+        }
+    }
+    return ready;
+}
+
+bool ServoBank::lookup(int id, ServoMapping& mapping) const {
+    if (id < 0 || (size_t)id >= mappings_.size()) {
+        return false;
+    }
+    mapping = mappings_[id];
+    return ready_[mapping.board];
+}
+
+uint16_t ServoBank::get_ticks(int id) {
+    ServoMapping m;
+    if (!lookup(id, m)) {
+        return 0;
+    }
+    return boards_[m.board]->getPWM(m.channel);
+}
+
+void ServoBank::write(const Update* updates, size_t count) {
+    struct Pending {
+        uint16_t mask = 0;
+        uint16_t on[PCA9685_CHANNELS] = {};
+        uint16_t off[PCA9685_CHANNELS] = {};
+    };
+    // boards are few, group on the stack by board index
+    Pending pending[8];
+    const size_t stack_boards = std::min<size_t>(boards_.size(), 8);
+    std::vector<Pending> overflow(boards_.size() > 8 ? boards_.size() - 8 : 0);
+
+    for (size_t i = 0; i < count; i++) {
+        ServoMapping m;
+        if (!lookup(updates[i].id, m)) {
+            continue;
+        }
+        Pending& p = m.board < stack_boards ? pending[m.board]
+                                            : overflow[m.board - 8];
+        p.mask |= 1u << m.channel;
+        p.off[m.channel] = updates[i].ticks;
+    }
+    for (size_t b = 0; b < boards_.size(); b++) {
+        Pending& p = b < stack_boards ? pending[b] : overflow[b - 8];
+        if (ready_[b]) {
+            boards_[b]->setPWMChannels(p.mask, p.on, p.off);
+        }
+    }
+}
+
+bool ServoBank::resync() {
+    bool in_sync = true;
+    for (size_t b = 0; b < boards_.size(); b++) {
+        if (ready_[b]) {
+            in_sync &= boards_[b]->resync();
+        }
+    }
+    return in_sync;
+}
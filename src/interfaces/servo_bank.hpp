@@ -0,0 +1,59 @@
+#pragma once
+
+#include "../hal/pwm_driver.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+struct ServoBoardConfig {
+    uint8_t address = PCA9685_I2C_ADDRESS;
+    float pwm_freq = 50;
+    uint32_t oscillator_hz = FREQUENCY_OSCILLATOR; // measured chip clock
+};
+
+struct ServoMapping {
+    uint8_t board = 0;
+    uint8_t channel = 0;
+};
+
+class ServoBank {
+    // Several PCA9685 boards on one I2C bus behind a single global servo id
+    // space: id n is channel n % 16 of board n / 16. A board that fails to
+    // come up keeps its ids, so the numbering doesn't shift, but they are
+    // unavailable: lookup() fails and writes to them are dropped.
+  public:
+    struct Update {
+        int id;
+        uint16_t ticks;
+    };
+
+    // Creates the driver for one board address
+    using DriverFactory = std::function<std::unique_ptr<PwmDriver>(uint8_t address)>;
+
+    // Brings up every board concurrently, returns how many came up
+    size_t begin(const std::vector<ServoBoardConfig>& boards, const DriverFactory& make_driver);
+
+    // False for ids out of range or on a board that failed to initialize
+    bool lookup(int id, ServoMapping& mapping) const;
+    bool available(int id) const {
+        ServoMapping m;
+        return lookup(id, m);
+    }
+
+    size_t size() const { return mappings_.size(); }
+    size_t board_count() const { return boards_.size(); }
+    PwmDriver& board(size_t index) { return *boards_[index]; }
+
+    uint16_t get_ticks(int id);
+    // Every board touched by the batch gets exactly one block write
+    void write(const Update* updates, size_t count);
+    bool resync();
+
+  private:
+    std::vector<std::unique_ptr<PwmDriver>> boards_;
+    std::vector<bool> ready_; // per board, whether begin() brought it up
+    std::vector<ServoMapping> mappings_;
+};
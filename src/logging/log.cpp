@@ -0,0 +1,330 @@
+#include "log.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace logging {
+
+namespace detail {
+std::atomic<Level> levels[static_cast<int>(Module::kCount)] = {
+    Level::kInfo, Level::kInfo, Level::kInfo, Level::kInfo,
+    Level::kInfo, Level::kInfo, Level::kInfo, Level::kInfo,
+};
+static_assert(static_cast<int>(Module::kCount) == 8, "initialize the new module's level");
+} // namespace detail
+
+namespace {
+
+constexpr const char* kLevelNames[] = {"trace", "debug", "info", "warn", "error", "off"};
+constexpr const char* kModuleNames[] = {"main", "command", "daq", "gpio",
+                                        "relay", "servo", "control", "mqtt"};
+constexpr size_t kRingSize = 1024; // records per thread, power of two
+constexpr auto kDrainPeriod = std::chrono::milliseconds(5);
+
+// Single-producer (the owning thread), single-consumer (whoever holds the
+// writer's drain lock) ring
+struct Ring {
+    Record slots[kRingSize];
+    std::atomic<size_t> head{0};
+    std::atomic<size_t> tail{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<bool> orphaned{false}; // owning thread has exited
+};
+
+class Writer {
+  public:
+    // Never destroyed (see writer()), so the thread runs until the process
+    // exits
+    Writer() : thread_(&Writer::run_, this) {}
+
+    void add(std::shared_ptr<Ring> ring) {
+        std::lock_guard<std::mutex> lock(rings_mutex_);
+        rings_.push_back(std::move(ring));
+    }
+
+    void set_output(int fd) { fd_ = fd; }
+    uint64_t dropped() const { return dropped_; }
+
+    void drain() {
+        std::lock_guard<std::mutex> lock(drain_mutex_);
+        {
+            std::lock_guard<std::mutex> rings_lock(rings_mutex_);
+            active_ = rings_;
+        }
+
+        uint64_t dropped = 0;
+        for (auto& ring : active_) {
+            size_t tail = ring->tail.load(std::memory_order_relaxed);
+            size_t head = ring->head.load(std::memory_order_acquire);
+            for (; tail != head; tail++) {
+                batch_.push_back(ring->slots[tail % kRingSize]);
+            }
+            ring->tail.store(tail, std::memory_order_release);
+            dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+        }
+        active_.clear();
+        prune_();
+
+        if (batch_.empty() && !dropped) {
+            return;
+        }
+        // each ring is already in order; interleave the threads by time
+        std::stable_sort(batch_.begin(), batch_.end(),
+                         [](const Record& a, const Record& b) {
+                             return a.timestamp_ns < b.timestamp_ns;
+                         });
+        out_.clear();
+        for (const Record& r : batch_) {
+            format_(r);
+        }
+        if (dropped) {
+            dropped_ += dropped;
+            out_ += "log: " + std::to_string(dropped) + " records dropped, ring full\n";
+        }
+        batch_.clear();
+        write_();
+    }
+
+  private:
+    void run_() {
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        while (true) {
+            wake_.wait_for(lock, kDrainPeriod);
+            lock.unlock();
+            drain();
+            lock.lock();
+        }
+    }
+
+    void prune_() {
+        std::lock_guard<std::mutex> lock(rings_mutex_);
+        for (size_t i = 0; i < rings_.size();) {
+            Ring& ring = *rings_[i];
+            if (ring.orphaned && ring.tail == ring.head) {
+                rings_[i] = std::move(rings_.back());
+                rings_.pop_back();
+            } else {
+                i++;
+            }
+        }
+    }
+
+    void format_(const Record& r) {
+        time_t seconds = static_cast<time_t>(r.timestamp_ns / 1000000000ull);
+        if (seconds != stamp_seconds_) {
+            tm local;
+            localtime_r(&seconds, &local);
+            strftime(stamp_, sizeof(stamp_), "%Y-%m-%d %H:%M:%S", &local);
+            stamp_seconds_ = seconds;
+        }
+        char head[80];
+        snprintf(head, sizeof(head), "%s.%06u %-5s %-7s ", stamp_,
+                 static_cast<unsigned>(r.timestamp_ns % 1000000000ull / 1000),
+                 level_name(r.level), module_name(r.module));
+        out_ += head;
+
+        int arg = 0;
+        for (const char* p = r.format; *p; p++) {
+            bool hex = std::strncmp(p, "{:x}", 4) == 0;
+            if ((p[0] == '{' && p[1] == '}') || hex) {
+                if (arg < r.nargs) {
+                    append_arg_(r, arg++, hex);
+                }
+                p += hex ? 3 : 1;
+            } else {
+                out_ += *p;
+            }
+        }
+        out_ += '\n';
+    }
+
+    void append_arg_(const Record& r, int n, bool hex) {
+        char buf[32];
+        const Record::Value& v = r.values[n];
+        switch (r.types[n]) {
+        case Record::kInt:
+            if (hex) snprintf(buf, sizeof(buf), "%llx", static_cast<unsigned long long>(v.i));
+            else snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(v.i));
+            break;
+        case Record::kUInt:
+            snprintf(buf, sizeof(buf), hex ? "%llx" : "%llu", static_cast<unsigned long long>(v.u));
+            break;
+        case Record::kDouble:
+            snprintf(buf, sizeof(buf), "%.10g", v.d);
+            break;
+        case Record::kBool:
+            snprintf(buf, sizeof(buf), "%s", v.u ? "true" : "false");
+            break;
+        case Record::kChar:
+            snprintf(buf, sizeof(buf), "%c", static_cast<char>(v.u));
+            break;
+        case Record::kText:
+            out_.append(r.text + v.text.offset, v.text.length);
+            return;
+        }
+        out_ += buf;
+    }
+
+    void write_() {
+        const char* data = out_.data();
+        size_t left = out_.size();
+        while (left) {
+            ssize_t n = ::write(fd_, data, left);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return; // nowhere left to report it
+            }
+            data += n;
+            left -= static_cast<size_t>(n);
+        }
+    }
+
+    std::mutex rings_mutex_;
+    std::vector<std::shared_ptr<Ring>> rings_;
+
+    std::mutex drain_mutex_; // one consumer at a time
+    std::vector<std::shared_ptr<Ring>> active_;
+    std::vector<Record> batch_;
+    std::string out_;
+    char stamp_[32] = "";
+    time_t stamp_seconds_ = -1;
+    std::atomic<int> fd_{STDERR_FILENO};
+    std::atomic<uint64_t> dropped_{0};
+
+    std::mutex wake_mutex_;
+    std::condition_variable wake_;
+    std::thread thread_;
+};
+
+// Leaked on purpose: detached threads keep logging while static
+// destructors run at exit, and must never find the writer gone. Whatever is
+// still queued at a normal exit is written by the atexit flush.
+Writer& writer() {
+    static Writer* instance = [] {
+        Writer* w = new Writer;
+        std::atexit([] { writer().drain(); });
+        return w;
+    }();
+    return *instance;
+}
+
+struct LocalRing {
+    std::shared_ptr<Ring> ring;
+    ~LocalRing() {
+        if (ring) ring->orphaned = true;
+    }
+};
+thread_local LocalRing local;
+
+} // namespace
+
+namespace detail {
+
+Record* claim() {
+    if (!local.ring) {
+        local.ring = std::make_shared<Ring>();
+        writer().add(local.ring);
+    }
+    Ring& ring = *local.ring;
+    size_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) >= kRingSize) {
+        ring.dropped.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    return &ring.slots[head % kRingSize];
+}
+
+void commit() {
+    Ring& ring = *local.ring;
+    ring.head.store(ring.head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+} // namespace detail
+
+const char* level_name(Level level) {
+    return kLevelNames[static_cast<int>(level)];
+}
+
+const char* module_name(Module module) {
+    return kModuleNames[static_cast<int>(module)];
+}
+
+bool parse_level(std::string_view name, Level& level) {
+    for (int i = 0; i <= static_cast<int>(Level::kOff); i++) {
+        if (name == kLevelNames[i]) {
+            level = static_cast<Level>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parse_module(std::string_view name, Module& module) {
+    for (int i = 0; i < static_cast<int>(Module::kCount); i++) {
+        if (name == kModuleNames[i]) {
+            module = static_cast<Module>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void set_level(Module module, Level level) {
+    detail::levels[static_cast<int>(module)] = level;
+}
+
+void set_level(Level level) {
+    for (auto& l : detail::levels) {
+        l = level;
+    }
+}
+
+Level level(Module module) {
+    return detail::levels[static_cast<int>(module)];
+}
+
+bool set_levels(std::string_view spec) {
+    bool ok = true;
+    while (!spec.empty()) {
+        size_t comma = spec.find(',');
+        std::string_view entry = spec.substr(0, comma);
+        spec = comma == std::string_view::npos ? std::string_view() : spec.substr(comma + 1);
+
+        size_t eq = entry.find('=');
+        Level lvl;
+        Module module;
+        if (eq == std::string_view::npos) {
+            if (parse_level(entry, lvl)) set_level(lvl);
+            else ok = false;
+        } else if (parse_module(entry.substr(0, eq), module) &&
+                   parse_level(entry.substr(eq + 1), lvl)) {
+            set_level(module, lvl);
+        } else {
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+void set_output(int fd) {
+    writer().set_output(fd);
+}
+
+void flush() {
+    writer().drain();
+}
+
+uint64_t dropped() {
+    return writer().dropped();
+}
+
+} // namespace logging
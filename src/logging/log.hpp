@@ -0,0 +1,184 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <time.h>
+#include <type_traits>
+
+// Asynchronous logger.
+//
+// A log call checks the module's level, then copies a timestamp, the format
+// pointer and the raw arguments into a fixed-size record in a ring owned by
+// the calling thread. Nothing is formatted and no syscall is made on that
+// path; when the ring is full the record is dropped and counted. A
+// background thread drains every ring, orders the records by time, formats
+// them and writes them out in one go.
+//
+// Format strings must be string literals (only the pointer is stored) and use
+// "{}" placeholders, or "{:x}" for hex integers. String arguments are copied,
+// up to Record::kTextSize bytes per record.
+//
+//     logging::warn(logging::Module::kGpio, "Pin {} not configured as output", pin);
+
+namespace logging {
+
+enum class Level : uint8_t { kTrace, kDebug, kInfo, kWarn, kError, kOff };
+
+enum class Module : uint8_t {
+    kMain,
+    kCommand,
+    kDaq,
+    kGpio,
+    kRelay,
+    kServo,
+    kControl,
+    kMqtt,
+    kCount
+};
+
+const char* level_name(Level level);
+const char* module_name(Module module);
+bool parse_level(std::string_view name, Level& level);
+bool parse_module(std::string_view name, Module& module);
+
+void set_level(Module module, Level level);
+void set_level(Level level); // every module
+Level level(Module module);
+// "info", "gpio=debug", "warn,servo=trace,mqtt=off" -- a bare level sets
+// every module, later entries override earlier ones
+bool set_levels(std::string_view spec);
+
+// Written to stderr unless redirected. Takes effect from the next batch.
+void set_output(int fd);
+// Writes out everything logged so far and blocks until it is written. Runs
+// by itself at a normal exit; call it before _exit() or abort().
+void flush();
+// Records lost to full rings since start
+uint64_t dropped();
+
+struct Record {
+    static constexpr int kMaxArgs = 8;
+    static constexpr int kTextSize = 96;
+
+    enum Type : uint8_t { kInt, kUInt, kDouble, kBool, kChar, kText };
+    struct Text {
+        uint8_t offset;
+        uint8_t length;
+    };
+    union Value {
+        int64_t i;
+        uint64_t u;
+        double d;
+        Text text;
+    };
+
+    uint64_t timestamp_ns; // CLOCK_REALTIME
+    const char* format;
+    Module module;
+    Level level;
+    uint8_t nargs;
+    uint8_t text_used;
+    Type types[kMaxArgs];
+    Value values[kMaxArgs];
+    char text[kTextSize];
+};
+
+namespace detail {
+
+extern std::atomic<Level> levels[static_cast<int>(Module::kCount)];
+
+// Next free slot in this thread's ring, or nullptr when it is full
+Record* claim();
+void commit();
+
+template <typename T>
+inline void encode(Record& r, const T& value) {
+    int n = r.nargs++;
+    if constexpr (std::is_same_v<T, bool>) {
+        r.types[n] = Record::kBool;
+        r.values[n].u = value;
+    } else if constexpr (std::is_same_v<T, char>) {
+        r.types[n] = Record::kChar;
+        r.values[n].u = static_cast<unsigned char>(value);
+    } else if constexpr (std::is_enum_v<T>) {
+        r.types[n] = Record::kInt;
+        r.values[n].i = static_cast<int64_t>(value);
+    } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+        r.types[n] = Record::kInt;
+        r.values[n].i = value;
+    } else if constexpr (std::is_integral_v<T>) {
+        r.types[n] = Record::kUInt;
+        r.values[n].u = value;
+    } else if constexpr (std::is_floating_point_v<T>) {
+        r.types[n] = Record::kDouble;
+        r.values[n].d = value;
+    } else {
+        std::string_view text;
+        if constexpr (std::is_convertible_v<const T&, const char*>) {
+            const char* s = value;
+            text = s ? std::string_view(s) : std::string_view("(null)");
+        } else {
+            text = std::string_view(value);
+        }
+        size_t length = std::min<size_t>(text.size(), Record::kTextSize - r.text_used);
+        std::memcpy(r.text + r.text_used, text.data(), length);
+        r.types[n] = Record::kText;
+        r.values[n].text = {r.text_used, static_cast<uint8_t>(length)};
+        r.text_used += length;
+    }
+}
+
+} // namespace detail
+
+inline bool enabled(Module module, Level level) {
+    return level >= detail::levels[static_cast<int>(module)].load(std::memory_order_relaxed);
+}
+
+template <typename... Args>
+inline void log(Module module, Level level, const char* format, const Args&... args) {
+    static_assert(sizeof...(Args) <= Record::kMaxArgs, "too many log arguments");
+    if (!enabled(module, level)) {
+        return;
+    }
+    Record* r = detail::claim();
+    if (!r) {
+        return;
+    }
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts); // vDSO, no syscall
+    r->timestamp_ns = static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+    r->format = format;
+    r->module = module;
+    r->level = level;
+    r->nargs = 0;
+    r->text_used = 0;
+    (detail::encode(*r, args), ...);
+    detail::commit();
+}
+
+template <typename... Args>
+inline void trace(Module module, const char* format, const Args&... args) {
+    log(module, Level::kTrace, format, args...);
+}
+template <typename... Args>
+inline void debug(Module module, const char* format, const Args&... args) {
+    log(module, Level::kDebug, format, args...);
+}
+template <typename... Args>
+inline void info(Module module, const char* format, const Args&... args) {
+    log(module, Level::kInfo, format, args...);
+}
+template <typename... Args>
+inline void warn(Module module, const char* format, const Args&... args) {
+    log(module, Level::kWarn, format, args...);
+}
+template <typename... Args>
+inline void error(Module module, const char* format, const Args&... args) {
+    log(module, Level::kError, format, args...);
+}
+
+} // namespace logging
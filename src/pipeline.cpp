@@ -0,0 +1,879 @@
+#include <bitset>
+#include <boost/json.hpp>
+#include <boost/system/error_code.hpp>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <future>
+#include <linux/i2c-dev.h>
+#include <memory>
+#include <random>
+#include <string>
+#include <sys/ioctl.h>
+#include <thread>
+#include <unistd.h>
+#include "pipeline.hpp"
+#include "logging/log.hpp"
+#include <csignal>
+
+using namespace std;
+using namespace std::chrono;
+namespace json = boost::json;
+
+
+// ———————— runtime configuration ——————————
+// loaded from the file named on the command line, reloaded on SIGHUP or a
+// reload_config command
+ConfigStore runtime_config;
+std::string config_path;
+std::mutex _reload_access;
+
+// ———————— Global flags ——————————
+bool has_daq = false;
+bool has_servo = false;
+bool has_io_expander = false;
+bool has_gpio_manager = false;
+
+// ———————— hardware ——————————
+// real or simulated devices, picked once at startup; reloads don't change it
+HalSettings hal_settings;
+std::string gpio_chip;
+std::unique_ptr<AnalogInput> analog_input;
+
+// ———————— device state ——————————
+StateStore device_state;
+
+// ———————— telemetry spool ——————————
+std::unique_ptr<TelemetrySpool> telemetry_spool;
+
+// ———————— black box ——————————
+std::unique_ptr<BlackBox> recorder;
+
+// ———————— replay ——————————
+std::unique_ptr<RecordingReplay> recording_replay;
+
+// ———————— telemetry streams ——————————
+const uint64_t run_id = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+TelemetryHistory telemetry_history;
+TelemetryHistory gpio_history;
+
+// ———————— I2C IO Expander ——————————
+std::unique_ptr<RelayExpander> io_expander;
+
+// ———————— servo driver ——————————
+// servo ids are global across boards: id n is channel n % 16 of board n / 16
+ServoBank servoBank;
+std::unique_ptr<ServoMotion> servoMotion;
+std::unique_ptr<ControlLoops> controlLoops;
+
+std::unique_ptr<GPIO_Manager> gpio_manager;
+
+// ———————— quadrature encoders ——————————
+// each decodes on its own thread; readers copy the shared_ptr and then read
+// the position lock-free
+std::map<int, std::shared_ptr<QuadratureEncoder>> encoders;
+boost::shared_mutex _encoder_access;
+
+
+// closed-loop feedback: latest sample of one DAQ channel
+ControlLoop::Feedback make_daq_feedback(int hat_id, int channel_id) {
+    return [hat_id, channel_id](double& value) {
+        return device_state.sensors.read().find(hat_id, channel_id, value);
+    };
+}
+
+// closed-loop feedback: position of a quadrature encoder. The loop keeps the
+// encoder alive even if it is removed from the table meanwhile.
+ControlLoop::Feedback make_encoder_feedback(int encoder_id) {
+    std::shared_ptr<QuadratureEncoder> encoder;
+    {
+        boost::shared_lock<boost::shared_mutex> lock{_encoder_access};
+        auto it = encoders.find(encoder_id);
+        if (it != encoders.end()) encoder = it->second;
+    }
+    return [encoder](double& value) {
+        if (!encoder) return false;
+        value = encoder->position();
+        return true;
+    };
+}
+
+// ———————— MQTT connections ——————————
+mqtt::connect_options make_connect_options(const MqttConnectionSettings& link, bool clean_session) {
+    return mqtt::connect_options_builder()
+        .clean_session(clean_session)
+        .max_inflight(link.max_inflight)
+        .keep_alive_interval(seconds(link.keepalive_s))
+        .automatic_reconnect(seconds(link.reconnect_min_s), seconds(link.reconnect_max_s))
+        .finalize();
+}
+
+// recv
+void dispatch_command(
+        mqtt::async_client_ptr cli,
+        const std::string& topic,
+        const std::string& m_str,
+        RelayExpander& io_expander,
+        ServoBank& servoBank,
+        ServoMotion& servoMotion,
+        GPIO_Manager& gpio_manager
+    ) {
+    logging::info(logging::Module::kCommand, "{}: {}", topic, m_str);
+
+    error_code ec;
+    boost::json::value parsed = boost::json::parse(m_str, ec);
+    if (ec) {
+        logging::warn(logging::Module::kCommand, "Parsing failed: {}", ec.message());
+        return;
+    }
+    
+    string type  = parsed.as_object().at("type").as_string().c_str();
+
+    if (type == "servo" && has_servo && parsed.as_object().contains("angle")) {
+        const auto& obj = parsed.as_object();
+        int id = obj.at("id").as_int64();
+        // in the channel's calibrated units, raw microseconds by default
+        double angle = obj.at("angle").to_number<double>();
+
+        // optional per-command motion limits, sticky for the channel
+        if (obj.contains("profile") || obj.contains("max_rate") ||
+            obj.contains("max_accel") || obj.contains("max_jerk")) {
+            MotionLimits limits;
+            if (obj.contains("profile") &&
+                !parse_motion_profile(obj.at("profile").as_string().c_str(), limits.profile)) {
+                logging::warn(logging::Module::kCommand, "Invalid servo profile: {}", obj.at("profile").as_string());
+                return;
+            }
+            if (obj.contains("max_rate")) limits.max_rate = obj.at("max_rate").to_number<double>();
+            if (obj.contains("max_accel")) limits.max_accel = obj.at("max_accel").to_number<double>();
+            if (obj.contains("max_jerk")) limits.max_jerk = obj.at("max_jerk").to_number<double>();
+            servoMotion.set_limits(id, limits);
+        }
+        if (!servoMotion.set_target(id, angle)) {
+            logging::warn(logging::Module::kCommand, "Invalid servo id: {}", id);
+        }
+    }
+
+    if (type == "servo_calibrate" && has_servo && parsed.as_object().contains("id")) {
+        const auto& obj = parsed.as_object();
+        int id = obj.at("id").as_int64();
+        ServoCalibration cal;
+        if (obj.contains("units") && !parse_servo_units(obj.at("units").as_string().c_str(), cal.units)) {
+            logging::warn(logging::Module::kCommand, "Invalid servo units: {}", obj.at("units").as_string());
+            return;
+        }
+        if (obj.contains("min")) cal.input_min = obj.at("min").to_number<double>();
+        if (obj.contains("max")) cal.input_max = obj.at("max").to_number<double>();
+        if (obj.contains("pulse_min")) cal.pulse_at_min = obj.at("pulse_min").to_number<double>();
+        if (obj.contains("pulse_max")) cal.pulse_at_max = obj.at("pulse_max").to_number<double>();
+        if (obj.contains("resolution")) cal.resolution = obj.at("resolution").to_number<double>();
+        if (obj.contains("oscillator_hz")) cal.oscillator_hz = obj.at("oscillator_hz").to_number<uint32_t>();
+        if (!servoMotion.set_calibration(id, cal)) {
+            logging::warn(logging::Module::kCommand, "Invalid servo id: {}", id);
+        }
+    }
+
+    if (type == "control_config" && has_servo && parsed.as_object().contains("id")) {
+        const auto& obj = parsed.as_object();
+        ControlLoopConfig config;
+        config.servo = obj.at("id").as_int64();
+        if (!servoBank.available(config.servo)) {
+            logging::warn(logging::Module::kCommand, "Invalid servo id: {}", config.servo);
+            return;
+        }
+        if (obj.contains("hat")) config.feedback_hat = obj.at("hat").as_int64();
+        if (obj.contains("channel")) config.feedback_channel = obj.at("channel").as_int64();
+        if (obj.contains("encoder")) config.feedback_encoder = obj.at("encoder").as_int64();
+        if (obj.contains("rate")) config.rate_hz = obj.at("rate").to_number<double>();
+        if (obj.contains("kp")) config.gains.kp = obj.at("kp").to_number<double>();
+        if (obj.contains("ki")) config.gains.ki = obj.at("ki").to_number<double>();
+        if (obj.contains("kd")) config.gains.kd = obj.at("kd").to_number<double>();
+        if (obj.contains("kff")) config.gains.kff = obj.at("kff").to_number<double>();
+        if (obj.contains("ff_offset")) config.gains.ff_offset = obj.at("ff_offset").to_number<double>();
+        if (obj.contains("min")) config.gains.output_min = obj.at("min").to_number<double>();
+        if (obj.contains("max")) config.gains.output_max = obj.at("max").to_number<double>();
+        if (obj.contains("tracking")) config.gains.tracking = obj.at("tracking").to_number<double>();
+        if (obj.contains("derivative_tau")) config.gains.derivative_tau = obj.at("derivative_tau").to_number<double>();
+        controlLoops->configure(config, config.feedback_encoder >= 0
+                                            ? make_encoder_feedback(config.feedback_encoder)
+                                            : make_daq_feedback(config.feedback_hat, config.feedback_channel));
+    }
+
+    if (type == "control" && has_servo && parsed.as_object().contains("id")) {
+        const auto& obj = parsed.as_object();
+        int servo = obj.at("id").as_int64();
+        bool known = true;
+        if (obj.contains("setpoint")) known = controlLoops->set_setpoint(servo, obj.at("setpoint").to_number<double>());
+        if (known && obj.contains("enable")) known = controlLoops->set_enabled(servo, obj.at("enable").as_bool());
+        if (obj.contains("remove") && obj.at("remove").as_bool()) controlLoops->remove(servo);
+        else if (!known) logging::warn(logging::Module::kCommand, "No control loop configured for servo {}", servo);
+    }
+
+    // runtime log levels: {"type": "log_level", "levels": "warn,gpio=debug"}
+    if (type == "log_level" && parsed.as_object().contains("levels")) {
+        std::string levels = parsed.at("levels").as_string().c_str();
+        if (!logging::set_levels(levels)) {
+            logging::warn(logging::Module::kCommand, "Invalid log levels: {}", levels);
+        }
+    }
+
+    if (type == "reload_config") {
+        reload_config(cli);
+    }
+
+    if (type == "servo_resync" && has_servo) {
+        // through the motion layer, which rebuilds the tick tables of a
+        // board that came back on another prescale
+        if (!servoMotion.resync()) {
+            logging::warn(logging::Module::kServo, "Servo driver shadow was out of sync with hardware; reloaded");
+        }
+    }
+
+    if (type == "relay" && has_io_expander) {
+        int pin = parsed.at("id").as_int64();
+        bool state = parsed.at("state").is_int64() ?
+                     (parsed.at("state").as_int64() != 0) :
+                     parsed.at("state").as_bool();
+
+        if (pin >= 0 && pin < 16) {
+            try {
+                // only the consumer changes relays, so this can't race
+                std::bitset<16> relays = device_state.relay_bits();
+                relays.set(pin, state);
+                io_expander.write_output(relays);
+                device_state.set_relays(relays);
+                if (recorder) recorder->record_relays(relays.to_ulong());
+            } catch (const std::exception& e) {
+                logging::warn(logging::Module::kCommand, "Error writing to IO Expander: {}", e.what());
+            }
+        }
+        else {
+            logging::warn(logging::Module::kCommand, "Invalid pin number: {}", pin);
+            return;
+        }
+    }
+
+    if (type == "gpio" && has_gpio_manager && parsed.as_object().contains("id")) {
+        int pin = parsed.at("id").as_int64();
+
+        // GPIO_Manager is thread-safe
+        if (parsed.as_object().contains("debounce_us")) {
+            // kernel debounce, v2 backend only
+            gpio_manager.set_debounce(pin, parsed.at("debounce_us").to_number<uint32_t>());
+        }
+        if (parsed.as_object().contains("mode")) {
+            std::string mode = parsed.at("mode").as_string().c_str();
+            if (mode == "input") {
+                // edges only report changes, seed the level now
+                int value;
+                if (gpio_manager.set_direction(pin, GPIO_Direction::kInput) && gpio_manager.read(pin, value)) {
+                    device_state.set_gpio(pin, value);
+                }
+            } else if (mode == "output") {
+                gpio_manager.set_direction(pin, GPIO_Direction::kOutput);
+                device_state.clear_gpio(pin);
+            } else {
+                logging::warn(logging::Module::kCommand, "Invalid GPIO mode: {}", mode);
+            }
+        } 
+        if (parsed.as_object().contains("state")) {
+            // bool state = parsed.at("state").is_int64() ? (parsed.at("state").as_int64() != 0) : parsed.at("state").as_bool();
+            int state = parsed.at("state").is_int64() ? 
+                        parsed.at("state").as_int64() : 
+                        (parsed.at("state").as_bool() ? 1 : 0);
+            gpio_manager.write(pin, state);
+        }
+    }
+
+    // pulse counter / frequency input, e.g. a turbine flowmeter:
+    // {"type": "gpio_counter", "id": 5, "edge": "rising", "window_ms": 250, "scale": 0.0125}
+    // "reset": true zeroes the count, "remove": true goes back to plain input
+    if (type == "gpio_counter" && has_gpio_manager && parsed.as_object().contains("id")) {
+        int pin = parsed.at("id").as_int64();
+        const auto& obj = parsed.as_object();
+        if (obj.contains("remove") && obj.at("remove").as_bool()) {
+            int value;
+            if (gpio_manager.clear_counter(pin) && gpio_manager.read(pin, value)) {
+                device_state.set_gpio(pin, value);
+            }
+            return;
+        }
+        if (obj.contains("reset") && obj.at("reset").as_bool()) {
+            gpio_manager.reset_counter(pin);
+            return;
+        }
+
+        GPIO_CounterConfig config;
+        if (obj.contains("edge")) {
+            std::string edge = obj.at("edge").as_string().c_str();
+            if (edge == "rising") config.edge = GPIO_Edge::kRising;
+            else if (edge == "falling") config.edge = GPIO_Edge::kFalling;
+            else if (edge == "both") config.edge = GPIO_Edge::kBoth;
+            else {
+                logging::warn(logging::Module::kCommand, "Invalid counter edge: {}", edge);
+                return;
+            }
+        }
+        if (obj.contains("window_ms")) config.window_ms = obj.at("window_ms").to_number<uint32_t>();
+        if (obj.contains("scale")) config.scale = obj.at("scale").to_number<double>();
+        if (gpio_manager.set_counter(pin, config)) {
+            // counted edges aren't reported individually any more
+            device_state.clear_gpio(pin);
+        }
+    }
+
+    // quadrature encoder on a pin pair:
+    // {"type": "encoder", "id": 0, "pin_a": 23, "pin_b": 24, "scale": 0.09, "debounce_us": 50}
+    // "zero": true (or a count) resets the position, "remove": true releases the pins
+    if (type == "encoder" && parsed.as_object().contains("id")) {
+        const auto& obj = parsed.as_object();
+        int id = obj.at("id").as_int64();
+        if (obj.contains("pin_a") && obj.contains("pin_b")) {
+            QuadratureConfig config;
+            config.pin_a = obj.at("pin_a").as_int64();
+            config.pin_b = obj.at("pin_b").as_int64();
+            if (obj.contains("debounce_us")) config.debounce_us = obj.at("debounce_us").to_number<uint32_t>();
+            if (obj.contains("scale")) config.scale = obj.at("scale").to_number<double>();
+            if (obj.contains("invert")) config.invert = obj.at("invert").as_bool();
+            {
+                // release the old request first, the pins may be the same
+                boost::unique_lock<boost::shared_mutex> lock{_encoder_access};
+                encoders.erase(id);
+            }
+            try {
+                auto encoder = std::make_shared<QuadratureEncoder>(make_gpio(hal_settings, gpio_chip), config);
+                encoder->start();
+                boost::unique_lock<boost::shared_mutex> lock{_encoder_access};
+                encoders[id] = std::move(encoder);
+            } catch (const std::exception& e) {
+                logging::warn(logging::Module::kCommand, "Encoder {} setup failed: {}", id, e.what());
+            }
+        }
+        std::shared_ptr<QuadratureEncoder> encoder;
+        {
+            boost::shared_lock<boost::shared_mutex> lock{_encoder_access};
+            auto it = encoders.find(id);
+            if (it != encoders.end()) encoder = it->second;
+        }
+        if (!encoder) {
+            logging::warn(logging::Module::kCommand, "No encoder with id {}", id);
+            return;
+        }
+        if (obj.contains("zero")) {
+            const auto& zero = obj.at("zero");
+            if (zero.is_bool()) {
+                if (zero.as_bool()) encoder->zero();
+            } else {
+                encoder->zero(zero.to_number<int64_t>());
+            }
+        }
+        if (obj.contains("remove") && obj.at("remove").as_bool()) {
+            // stops once no control loop holds it either
+            boost::unique_lock<boost::shared_mutex> lock{_encoder_access};
+            encoders.erase(id);
+        }
+    }
+
+    // timestamp clock for all input edges:
+    // {"type": "gpio", "event_clock": "realtime"}
+    if (type == "gpio" && has_gpio_manager && parsed.as_object().contains("event_clock")) {
+        std::string clock = parsed.at("event_clock").as_string().c_str();
+        if (clock == "monotonic") {
+            gpio_manager.set_event_clock(GPIO_EventClock::kMonotonic);
+        } else if (clock == "realtime") {
+            gpio_manager.set_event_clock(GPIO_EventClock::kRealtime);
+        } else {
+            logging::warn(logging::Module::kCommand, "Invalid GPIO event clock: {}", clock);
+        }
+    }
+
+    // several outputs at once, applied simultaneously:
+    // {"type": "gpio", "states": {"17": 1, "27": 0}}
+    if (type == "gpio" && has_gpio_manager && parsed.as_object().contains("states")) {
+        std::map<int, int> states;
+        try {
+            for (const auto& entry : parsed.at("states").as_object()) {
+                const auto& v = entry.value();
+                states[std::stoi(std::string(entry.key()))] =
+                    v.is_bool() ? (v.as_bool() ? 1 : 0) : (v.as_int64() != 0);
+            }
+        } catch (const std::exception& e) {
+            logging::warn(logging::Module::kCommand, "Invalid GPIO states: {}", e.what());
+            return;
+        }
+        gpio_manager.write_many(states);
+    }
+}
+
+void consumer_func(
+        mqtt::async_client_ptr cli, 
+        RelayExpander& io_expander, 
+        ServoBank& servoBank,
+        ServoMotion& servoMotion,
+        GPIO_Manager& gpio_manager
+
+    ) {
+    while (true) {
+        auto msg = cli->consume_message();
+        if (!msg) {
+            this_thread::sleep_for(milliseconds(1)); // prevent tight looping
+            continue;
+        }
+        if (recorder) recorder->record_command(msg->get_topic(), msg->to_string());
+        try {
+            dispatch_command(cli, msg->get_topic(), msg->to_string(), io_expander, servoBank, servoMotion, gpio_manager);
+        } catch (const std::exception& e) {
+            // missing or mistyped field, drop the command but keep consuming
+            logging::warn(logging::Module::kCommand, "Invalid command: {}", e.what());
+        }
+    }
+}
+
+// ———————— MQTT publisher ——————————
+// one telemetry message from the current state
+std::string serialize_telemetry(uint64_t seq) {
+    boost::json::array json_sensor_data, json_gpio_data, json_counter_data, json_encoder_data, json_relay_data, json_servo_data, json_control_data;
+
+    // one snapshot per section, each internally consistent
+    const SensorState sensors = device_state.sensors.read();
+    const GpioState gpios = device_state.gpio.read();
+    const RelayState relays = device_state.relays.read();
+    const ServoState servos = device_state.servos.read();
+    {
+        for (uint32_t i = 0; i < sensors.count; i++) {
+            const sensor_datapoint& sd = sensors.samples[i];
+            boost::json::object se;
+            se["hat_id"]   = sd.hat_id;
+            se["channel_id"] = sd.channel_id;
+            se["value"] = sd.value;
+            se["timestamp"] = sd.time;
+            json_sensor_data.push_back(se);
+        }
+    }
+    for (int pin = 0; pin < 64; pin++) {
+        if (!gpios.has(pin)) continue;
+        boost::json::object g;
+        g["pin_id"] = pin;
+        g["state"] = gpios.level(pin);
+        json_gpio_data.push_back(g);
+    }
+    if (has_gpio_manager) {
+        // lock-free, straight from the counters
+        for (const auto& r : gpio_manager->read_counters()) {
+            boost::json::object c;
+            c["pin_id"] = r.pin;
+            c["count"] = r.count;
+            c["period_us"] = r.period_us;
+            c["frequency"] = r.frequency_hz;
+            c["total"] = r.total;
+            c["rate"] = r.rate;
+            c["timestamp_ns"] = r.timestamp_ns;
+            json_counter_data.push_back(c);
+        }
+    }
+    {
+        boost::shared_lock<boost::shared_mutex> lock(_encoder_access);
+        for (const auto& [id, encoder] : encoders) {
+            boost::json::object e;
+            e["id"] = id;
+            e["count"] = encoder->count();
+            e["position"] = encoder->position();
+            e["errors"] = encoder->errors();
+            e["timestamp_ns"] = encoder->last_edge_ns();
+            json_encoder_data.push_back(e);
+        }
+    }
+    for (const auto& loop : controlLoops->status()) {
+        boost::json::object c;
+        c["servo_id"] = loop.config.servo;
+        c["enabled"] = loop.enabled;
+        c["feedback_ok"] = loop.feedback_ok;
+        c["setpoint"] = loop.setpoint;
+        c["measurement"] = loop.measurement;
+        c["error"] = loop.terms.error;
+        c["p"] = loop.terms.p;
+        c["i"] = loop.terms.i;
+        c["d"] = loop.terms.d;
+        c["ff"] = loop.terms.ff;
+        c["output"] = loop.terms.output;
+        c["saturated"] = loop.terms.saturated;
+        c["period_us"] = loop.period_us;
+        c["max_jitter_us"] = loop.max_jitter_us;
+        c["exec_us"] = loop.exec_us;
+        c["overruns"] = loop.overruns;
+        json_control_data.push_back(c);
+    }
+    for (size_t i = 0; i < 16; ++i) {
+        boost::json::object se;
+        se["id"] = i;
+        se["state"] = (relays.bits >> i) & 1;
+        json_relay_data.push_back(se);
+    }
+    for (uint32_t id = 0; id < servos.count; id++) {
+        if (!servos.servos[id].ticks) continue; // never driven
+        boost::json::object se;
+        se["id"] = id;
+        se["ticks"] = servos.servos[id].ticks;
+        se["position"] = servos.servos[id].position;
+        json_servo_data.push_back(se);
+    }
+    boost::json::value payload = {{"run", run_id}
+                                  , {"seq", seq}
+                                  , {"sensors", json_sensor_data}
+                                  , {"counters", json_counter_data}
+                                  , {"encoders", json_encoder_data}
+                                  , {"gpios", json_gpio_data}
+                                  , {"control", json_control_data}
+                                  , {"relay", json_relay_data}
+                                  , {"servo", json_servo_data}
+                                  };
+    return boost::json::serialize(payload);
+}
+
+void publish_telemetry(mqtt::async_client_ptr cli, const std::string& topic, const std::string& payload,
+                       bool wait) {
+    if (cli->is_connected()) {
+        try {
+            auto token = cli->publish(topic, payload);
+            if (wait) token->wait();
+            return;
+        } catch (const std::exception& e) {
+            // dropped between the check and the send
+            logging::debug(logging::Module::kMqtt, "Telemetry publish failed: {}", e.what());
+        }
+    }
+    if (telemetry_spool && !telemetry_spool->append(topic, payload)) {
+        logging::warn(logging::Module::kMqtt, "Telemetry frame of {} bytes is larger than a spool segment",
+                      payload.size());
+    }
+}
+
+size_t replay_spool(mqtt::async_client_ptr cli, size_t max_frames) {
+    if (!telemetry_spool || !cli->is_connected()) return 0;
+    auto config = runtime_config.get();
+    const int qos = config->mqtt.qos;
+    const auto timeout = seconds(config->mqtt.telemetry.keepalive_s);
+    return telemetry_spool->replay(max_frames, [&](const std::vector<TelemetrySpool::Frame>& frames) {
+        // a frame leaves the spool only once the broker has acknowledged it,
+        // so a connection lost mid-batch loses nothing
+        std::vector<mqtt::delivery_token_ptr> tokens;
+        try {
+            for (const auto& frame : frames) {
+                tokens.push_back(cli->publish(frame.topic, frame.payload, qos, false));
+            }
+        } catch (const std::exception&) {
+            // in-flight window full or connection lost, the rest go next time
+        }
+        size_t delivered = 0;
+        for (const auto& token : tokens) {
+            try {
+                if (!token->wait_for(timeout)) break;
+            } catch (const std::exception& e) {
+                logging::debug(logging::Module::kMqtt, "Spooled frame not delivered: {}", e.what());
+                break;
+            }
+            delivered++;
+        }
+        return delivered;
+    });
+}
+
+void publisher_func(mqtt::async_client_ptr cli) {
+    // spooled frames go out interleaved with live ones, at most
+    // catch_up_per_s, so the backlog can't starve live telemetry or flood
+    // the broker after an outage
+    double replay_credit = 0;
+    auto last = steady_clock::now();
+    while (true) {
+        auto config = runtime_config.get();
+        const uint64_t seq = telemetry_history.next_seq();
+        const std::string payload = serialize_telemetry(seq);
+        telemetry_history.record(seq, payload);
+        publish_telemetry(cli, config->mqtt.telemetry_topic, payload, true);
+
+        if (telemetry_spool) {
+            auto now = steady_clock::now();
+            replay_credit += duration<double>(now - last).count() * config->spool.catch_up_per_s;
+            replay_credit = std::min(replay_credit, std::max(1.0, config->spool.catch_up_per_s / 10.0));
+            last = now;
+            if (replay_credit >= 1) {
+                replay_credit -= replay_spool(cli, static_cast<size_t>(replay_credit));
+            }
+        }
+
+        this_thread::sleep_for(milliseconds(config->publish_period_ms));
+    }
+}
+
+// ———————— servo outputs ——————————
+// ServoMotion observer: what every servo is being driven to
+void publish_servo_outputs(const std::vector<ServoMotion::Output>& outputs) {
+    device_state.servos.update([&](ServoState& state) {
+        for (const auto& output : outputs) {
+            if (output.id < 0 || (size_t)output.id >= ServoState::kMaxServos) continue;
+            state.servos[output.id] = {output.ticks, static_cast<float>(output.position)};
+            state.count = std::max<uint32_t>(state.count, output.id + 1);
+        }
+    });
+    if (recorder) {
+        for (const auto& output : outputs) {
+            recorder->record_servo(output.id, output.ticks, static_cast<float>(output.position));
+        }
+    }
+}
+
+// ———————— DAQ sampling ——————————
+void publish_samples(const std::vector<sensor_datapoint>& samples) {
+    device_state.publish_samples(samples);
+    if (recorder) recorder->record_samples(samples);
+}
+
+// one pass over every channel, handed to the publisher in one swap
+void sample_once(const std::vector<int>& daq_hats, const RuntimeConfig& config) {
+    std::vector<sensor_datapoint> new_data;
+    for (int hat_id : daq_hats) { // Iterate over all DAQ hats
+        for (int channel : config.daq.channels) { // Iterate over all channels for each DAQ hat
+            sensor_datapoint sd;
+            sd.hat_id = hat_id;
+            sd.channel_id = channel;
+
+            const auto now = std::chrono::system_clock::now();
+            if (!analog_input->read(hat_id, channel, sd.value)) {
+                continue; // keep the channel out of this pass rather than publish garbage
+            }
+            // ms since epoch, with the sub-ms part kept for latency measurements
+            sd.time = std::chrono::duration<double, std::milli>(now.time_since_epoch()).count();
+
+            new_data.push_back(sd);
+        }
+    }
+    publish_samples(new_data);
+}
+
+// data sampling thread
+// channels and period come from the live config, so a reload takes effect
+// on the next pass without interrupting the channels it didn't touch
+void sample_func(const std::vector<int>& daq_hats) {
+    if (!has_daq) return;
+    while (true) {
+        auto config = runtime_config.get();
+        sample_once(daq_hats, *config);
+
+        // sampling frequency
+        this_thread::sleep_for(microseconds(config->daq.sample_period_us));
+    }
+}
+
+// ———————— GPIO edge events ——————————
+// called from the GPIO_Manager monitor thread for every input transition
+void gpio_event_func(mqtt::async_client_ptr cli, const GPIO_Event& event) {
+    device_state.set_gpio(event.pin, event.value);
+    if (recorder) recorder->record_gpio(event.pin, event.value, event.timestamp_ns);
+    const uint64_t seq = gpio_history.next_seq();
+    boost::json::object e;
+    e["run"] = run_id;
+    e["seq"] = seq;
+    e["pin_id"] = event.pin;
+    e["state"] = event.value;
+    e["timestamp_ns"] = event.timestamp_ns;
+    const std::string payload = boost::json::serialize(e);
+    gpio_history.record(seq, payload);
+    // don't wait for delivery, the next edge may already be queued
+    publish_telemetry(cli, runtime_config.get()->mqtt.gpio_topic, payload, false);
+}
+
+// ———————— replay ——————————
+void replay_func(mqtt::async_client_ptr cli) {
+    // replayed edges come stamped on the system clock; live ones are on the
+    // configured event clock
+    int64_t to_event_clock = 0;
+    if (runtime_config.get()->gpio.event_clock != "realtime") {
+        to_event_clock = duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count() -
+                         duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count();
+    }
+    if (recording_replay->speed() > 0) {
+        logging::info(logging::Module::kMain, "Replaying {} at {}x", recording_replay->path(), recording_replay->speed());
+    } else {
+        logging::info(logging::Module::kMain, "Replaying {} as fast as possible", recording_replay->path());
+    }
+    const auto started = steady_clock::now();
+    try {
+        recording_replay->run(publish_samples, [&](const GPIO_Event& event) {
+            GPIO_Event live = event;
+            live.timestamp_ns += to_event_clock;
+            gpio_event_func(cli, live);
+        });
+    } catch (const std::exception& e) {
+        logging::error(logging::Module::kMain, "Replay stopped: {}", e.what());
+        return;
+    }
+    // the last values stay in the device state
+    logging::info(logging::Module::kMain, "Replay finished: {} passes, {} GPIO events in {} ms",
+                  recording_replay->passes(), recording_replay->gpio_events(),
+                  duration_cast<milliseconds>(steady_clock::now() - started).count());
+}
+
+// ———————— backfill ——————————
+void serve_backfill(mqtt::async_client_ptr cli, const std::string& request) {
+    logging::debug(logging::Module::kMqtt, "Backfill request: {}", request);
+    boost::json::value parsed = boost::json::parse(request);
+    const boost::json::object& req = parsed.as_object();
+    const std::string stream = req.at("stream").as_string().c_str();
+    const TelemetryHistory* history = stream == "telemetry" ? &telemetry_history
+                                    : stream == "gpio"      ? &gpio_history
+                                                            : nullptr;
+    if (!history) {
+        logging::warn(logging::Module::kMqtt, "Backfill request for unknown stream {}", stream);
+        return;
+    }
+    const uint64_t from = req.at("from").to_number<uint64_t>();
+    const uint64_t to = req.at("to").to_number<uint64_t>();
+    const boost::json::value* id = req.if_contains("id");
+    const std::string prefix = "{\"id\":" + (id ? boost::json::serialize(*id) : std::string("null")) +
+                               ",\"stream\":\"" + stream + "\"";
+
+    // copied out first so the producers aren't held up while this publishes
+    std::vector<std::string> frames;
+    history->range(from, to, [&](uint64_t, const std::string& payload) {
+        frames.push_back(prefix + ",\"frame\":" + payload + "}");
+    });
+
+    const std::string topic = runtime_config.get()->mqtt.backfill_response_topic;
+    size_t served = 0;
+    try {
+        for (const auto& frame : frames) {
+            cli->publish(topic, frame);
+            served++;
+        }
+    } catch (const std::exception& e) {
+        logging::warn(logging::Module::kMqtt, "Backfill of {} stopped after {} frames: {}", stream, served, e.what());
+    }
+    boost::json::object done;
+    done["id"] = id ? *id : boost::json::value(nullptr);
+    done["stream"] = stream;
+    done["done"] = true;
+    done["served"] = served;
+    done["oldest"] = history->oldest();
+    done["newest"] = history->newest();
+    cli->publish(topic, boost::json::serialize(done));
+}
+
+void backfill_func(mqtt::async_client_ptr cli) {
+    while (true) {
+        auto msg = cli->consume_message();
+        if (!msg) {
+            this_thread::sleep_for(milliseconds(1)); // prevent tight looping
+            continue;
+        }
+        try {
+            serve_backfill(cli, msg->to_string());
+        } catch (const std::exception& e) {
+            logging::warn(logging::Module::kMqtt, "Invalid backfill request: {}", e.what());
+        }
+    }
+}
+
+// ———————— configuration reload ——————————
+// lines, debounce and event clock; used at startup and on reload
+void configure_gpio(const GpioSettings& gpio) {
+    const GPIO_EventClock clock =
+        gpio.event_clock == "realtime" ? GPIO_EventClock::kRealtime : GPIO_EventClock::kMonotonic;
+    // one call, so a reload only re-requests the groups whose lines changed
+    if (!gpio_manager->configure(gpio.outputs, gpio.inputs, gpio.debounce_us, clock)) {
+        logging::error(logging::Module::kGpio, "Some GPIO lines could not be configured");
+    }
+    device_state.set_gpio_inputs(gpio_manager->read_all_inputs());
+}
+
+// Applies what can change while running. Sample channels and periods, topics
+// and log levels are picked up by the threads from the new snapshot; GPIO
+// lines are re-requested only if their section changed. Device addresses
+// and the broker connection are only read at startup.
+void apply_config(const RuntimeConfig& old, const RuntimeConfig& next, mqtt::async_client_ptr cli) {
+    if (!next.log_levels.empty() && !logging::set_levels(next.log_levels)) {
+        logging::warn(logging::Module::kMain, "Invalid log_levels: {}", next.log_levels);
+    }
+
+    const GpioSettings& a = old.gpio;
+    const GpioSettings& b = next.gpio;
+    if (has_gpio_manager && (a.outputs != b.outputs || a.inputs != b.inputs ||
+                             a.debounce_us != b.debounce_us || a.event_clock != b.event_clock)) {
+        configure_gpio(b);
+    }
+
+    if (cli && old.mqtt.command_topic != next.mqtt.command_topic) {
+        cli->unsubscribe(old.mqtt.command_topic);
+        cli->subscribe(next.mqtt.command_topic, next.mqtt.qos);
+    }
+
+    if (a.chip != b.chip || old.hal != next.hal || old.relay.bus != next.relay.bus ||
+        old.relay.address != next.relay.address ||
+        old.servo.boards != next.servo.boards ||
+        old.mqtt.address != next.mqtt.address || old.mqtt.client_id != next.mqtt.client_id ||
+        old.mqtt.command != next.mqtt.command || old.mqtt.telemetry != next.mqtt.telemetry ||
+        old.spool.dir != next.spool.dir || old.spool.segment_mb != next.spool.segment_mb ||
+        old.spool.segments != next.spool.segments || old.history_frames != next.history_frames ||
+        old.mqtt.backfill_topic != next.mqtt.backfill_topic || old.recorder != next.recorder) {
+        logging::warn(logging::Module::kMain,
+                      "Device or broker settings changed; they take effect after a restart");
+    }
+}
+
+bool reload_config(mqtt::async_client_ptr cli) {
+    std::lock_guard<std::mutex> lock(_reload_access);
+    if (config_path.empty()) {
+        logging::warn(logging::Module::kMain, "No config file to reload");
+        return false;
+    }
+    auto next = std::make_shared<RuntimeConfig>();
+    std::string error;
+    if (!load_config(config_path, *next, error)) {
+        logging::error(logging::Module::kMain, "Config reload failed, keeping current settings: {}", error);
+        return false;
+    }
+    auto old = runtime_config.swap(next);
+    apply_config(*old, *next, cli);
+    logging::info(logging::Module::kMain, "Reloaded {}", config_path);
+    return true;
+}
+
+// SIGHUP, SIGINT and SIGTERM are blocked in every thread and taken here
+// synchronously, so the reload runs in normal thread context. INT and TERM
+// close the recording before exiting, the other threads are left running
+// until then. The thread runs from the top of main(); until startup hands
+// over the command connection, a reload is refused and INT or TERM exit
+// straight away, even out of a hanging broker connect. A recording opened by
+// then is left as a crash would leave it, which the reader recovers.
+void signal_func(std::shared_future<mqtt::async_client_ptr> command_cli) {
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGHUP);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGTERM);
+    while (true) {
+        int sig;
+        if (sigwait(&set, &sig) != 0) continue;
+        bool started = command_cli.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        if (sig == SIGHUP) {
+            if (started) {
+                reload_config(command_cli.get());
+            } else {
+                logging::warn(logging::Module::kMain, "Still starting up, ignoring SIGHUP");
+            }
+            continue;
+        }
+        if (!started) {
+            logging::info(logging::Module::kMain, "Stopping on signal {} during startup", sig);
+            logging::flush();
+            _exit(1);
+        }
+        logging::info(logging::Module::kMain, "Stopping on signal {}", sig);
+        if (recorder) recorder->seal();
+        logging::flush();
+        _exit(0);
+    }
+}
+
@@ -0,0 +1,140 @@
+#pragma once
+
+// The ground station's shared state and thread bodies. main() opens the
+// devices into these globals and starts the threads; the benchmarks drive
+// the same functions against simulated devices.
+
+#include "mqtt/async_client.h"
+#include <boost/thread/shared_mutex.hpp>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "interfaces/servo_bank.hpp"
+#include "control/servo_motion.hpp"
+#include "control/control_loop.hpp"
+#include "hal/hal.hpp"
+#include "interfaces/gpio_manager.hpp"
+#include "interfaces/quadrature_encoder.hpp"
+#include "config/config.hpp"
+#include "state/state_store.hpp"
+#include "spool/telemetry_spool.hpp"
+#include "spool/telemetry_history.hpp"
+#include "recorder/black_box.hpp"
+#include "recorder/recording_replay.hpp"
+
+// ———————— runtime configuration ——————————
+extern ConfigStore runtime_config;
+extern std::string config_path;
+extern std::mutex _reload_access;
+
+// ———————— Global flags ——————————
+extern bool has_daq;
+extern bool has_servo;
+extern bool has_io_expander;
+extern bool has_gpio_manager;
+
+// ———————— hardware ——————————
+extern HalSettings hal_settings;
+extern std::string gpio_chip;
+extern std::unique_ptr<AnalogInput> analog_input;
+
+// ———————— device state ——————————
+// sensors, GPIO input levels, relays and servo outputs, see StateStore
+extern StateStore device_state;
+
+// ———————— relays ——————————
+extern std::unique_ptr<RelayExpander> io_expander;
+
+// ———————— servos ——————————
+extern ServoBank servoBank;
+extern std::unique_ptr<ServoMotion> servoMotion;
+extern std::unique_ptr<ControlLoops> controlLoops;
+
+// ———————— GPIO ——————————
+extern std::unique_ptr<GPIO_Manager> gpio_manager;
+
+// ———————— telemetry spool ——————————
+// null unless spool.dir is set
+extern std::unique_ptr<TelemetrySpool> telemetry_spool;
+
+// ———————— black box ——————————
+// null unless recorder.dir is set; gets every sample, command, relay and
+// servo output and GPIO input event
+extern std::unique_ptr<BlackBox> recorder;
+
+// ———————— replay ——————————
+// null unless started with --replay; stands in for the DAQ and the GPIO
+// inputs
+extern std::unique_ptr<RecordingReplay> recording_replay;
+
+// ———————— telemetry streams ——————————
+// Every telemetry and GPIO event frame carries "run" and its stream's "seq";
+// the last history_frames of each stream are kept for backfill requests.
+// run changes on every start, so a console can tell a restart (and spooled
+// frames from an earlier run) from a gap.
+extern const uint64_t run_id;
+extern TelemetryHistory telemetry_history;
+extern TelemetryHistory gpio_history;
+
+extern std::map<int, std::shared_ptr<QuadratureEncoder>> encoders;
+extern boost::shared_mutex _encoder_access;
+
+ControlLoop::Feedback make_daq_feedback(int hat_id, int channel_id);
+ControlLoop::Feedback make_encoder_feedback(int encoder_id);
+
+// Connect options for one of the two broker connections. The command
+// connection keeps its session (clean_session false) so commands sent while
+// it was down are delivered on reconnect; telemetry doesn't need one.
+mqtt::connect_options make_connect_options(const MqttConnectionSettings& link, bool clean_session);
+
+// Handles one command message. Throws if a field has the wrong type.
+void dispatch_command(mqtt::async_client_ptr cli, const std::string& topic, const std::string& m_str,
+                      RelayExpander& io_expander, ServoBank& servoBank, ServoMotion& servoMotion,
+                      GPIO_Manager& gpio_manager);
+// cli is the command connection; dispatch_command uses it to resubscribe
+// after a reload
+void consumer_func(mqtt::async_client_ptr cli, RelayExpander& io_expander, ServoBank& servoBank,
+                   ServoMotion& servoMotion, GPIO_Manager& gpio_manager);
+
+std::string serialize_telemetry(uint64_t seq);
+// Sends one frame on the telemetry connection (waiting for delivery if
+// wait), or spools it while the broker can't be reached
+void publish_telemetry(mqtt::async_client_ptr cli, const std::string& topic, const std::string& payload,
+                       bool wait);
+// Replays up to max_frames spooled frames at mqtt.qos if connected, waiting
+// for their delivery; returns how many were delivered
+size_t replay_spool(mqtt::async_client_ptr cli, size_t max_frames);
+// cli is the telemetry connection, which also carries GPIO events
+void publisher_func(mqtt::async_client_ptr cli);
+
+void publish_servo_outputs(const std::vector<ServoMotion::Output>& outputs);
+
+// A sampling pass, live or replayed: to the device state and the recorder
+void publish_samples(const std::vector<sensor_datapoint>& samples);
+void sample_once(const std::vector<int>& daq_hats, const RuntimeConfig& config);
+void sample_func(const std::vector<int>& daq_hats);
+
+void gpio_event_func(mqtt::async_client_ptr cli, const GPIO_Event& event);
+
+// Plays recording_replay through publish_samples() and gpio_event_func(),
+// in place of sample_func and the GPIO event monitor
+void replay_func(mqtt::async_client_ptr cli);
+
+// Answers one backfill request,
+//     {"stream": "telemetry" | "gpio", "from": 100, "to": 180, "id": <anything>}
+// by publishing each held frame in the range on the response topic as
+//     {"id": ..., "stream": ..., "frame": <the frame as first sent>}
+// followed by
+//     {"id": ..., "stream": ..., "done": true, "served": 75, "oldest": 106, "newest": 2105}
+// Frames older than "oldest" are gone. Throws if a field has the wrong type.
+void serve_backfill(mqtt::async_client_ptr cli, const std::string& request);
+// cli is the telemetry connection, subscribed to the backfill topic
+void backfill_func(mqtt::async_client_ptr cli);
+
+void configure_gpio(const GpioSettings& gpio);
+void apply_config(const RuntimeConfig& old, const RuntimeConfig& next, mqtt::async_client_ptr cli);
+bool reload_config(mqtt::async_client_ptr cli);
+void signal_func(std::shared_future<mqtt::async_client_ptr> command_cli);
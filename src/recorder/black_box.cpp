@@ -0,0 +1,302 @@
+#include "black_box.hpp"
+
+#include "logging/log.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace recording;
+
+namespace {
+
+int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+// count and used are published after the data they cover
+void publish(uint32_t& field, uint32_t value) {
+    std::atomic_ref<uint32_t>(field).store(value, std::memory_order_release);
+}
+
+std::runtime_error recorder_error(const std::string& what, const std::string& path) {
+    return std::runtime_error("recorder: " + what + " " + path + ": " + std::strerror(errno));
+}
+
+} // namespace
+
+BlackBox::BlackBox(const RecorderSettings& settings, uint64_t run_id) {
+    pages_ = (size_t{settings.size_mb} << 20) / kPageSize;
+    if (settings.dir.empty() || pages_ < 2) {
+        throw std::runtime_error("recorder: needs a directory and a nonzero size");
+    }
+    if (mkdir(settings.dir.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw recorder_error("cannot create", settings.dir);
+    }
+    path_ = settings.dir + "/novaground-" + std::to_string(run_id) + ".rec";
+
+    fd_ = open(path_.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        throw recorder_error("cannot create", path_);
+    }
+    // allocate every block up front so a full disk fails here rather than
+    // as SIGBUS in the middle of a test
+    if (int err = posix_fallocate(fd_, 0, pages_ * kPageSize)) {
+        close(fd_);
+        errno = err;
+        throw recorder_error("cannot allocate", path_);
+    }
+    void* base = mmap(nullptr, pages_ * kPageSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (base == MAP_FAILED) {
+        close(fd_);
+        throw recorder_error("cannot map", path_);
+    }
+    base_ = static_cast<uint8_t*>(base);
+
+    header_ = reinterpret_cast<FileHeader*>(base_);
+    header_->magic = kFileMagic;
+    header_->version = kVersion;
+    header_->page_size = kPageSize;
+    header_->file_bytes = pages_ * kPageSize;
+    header_->run_id = run_id;
+    header_->created_ns = now_ns();
+    header_->checkpoint_pages = 1;
+    checkpoint();
+
+    checkpointer_ = std::thread(&BlackBox::checkpoint_func_, this, std::max<uint32_t>(settings.checkpoint_ms, 1));
+    logging::info(logging::Module::kMain, "Recording to {}", path_);
+}
+
+BlackBox::~BlackBox() {
+    {
+        std::lock_guard<std::mutex> lock(stop_mutex_);
+        stop_ = true;
+    }
+    stop_cv_.notify_one();
+    checkpointer_.join();
+    seal();
+    munmap(base_, pages_ * kPageSize);
+    close(fd_);
+}
+
+void BlackBox::seal() {
+    size_t used;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (sealed_) return;
+        sealed_ = true;
+        used = next_page_;
+    }
+    header_->closed = 1;
+    checkpoint();
+    // the rest was never written; readers stop at the first page without a
+    // block anyway, this just gives the space back
+    if (ftruncate(fd_, used * kPageSize) != 0) {
+        logging::warn(logging::Module::kMain, "Could not trim {}: {}", path_, std::strerror(errno));
+    }
+    logging::info(logging::Module::kMain, "Closed {} ({} blocks)", path_, used - 1);
+}
+
+BlockHeader* BlackBox::block_(size_t page) const {
+    return reinterpret_cast<BlockHeader*>(base_ + page * kPageSize);
+}
+
+// mutex_ held
+void BlackBox::mark_full_() {
+    if (!full_) {
+        full_ = true;
+        logging::error(logging::Module::kMain, "Recording {} is full, no longer recording", path_);
+    }
+}
+
+// mutex_ held. The next page, as an empty block; nullptr once the file is full.
+BlockHeader* BlackBox::new_block_(BlockType type, uint16_t key) {
+    if (next_page_ >= pages_) {
+        mark_full_();
+        return nullptr;
+    }
+    BlockHeader* block = block_(next_page_);
+    block->type = static_cast<uint16_t>(type);
+    block->key = key;
+    block->count = 0;
+    block->used = 0;
+    block->first_ns = 0;
+    block->last_ns = 0;
+    std::atomic_ref<uint32_t>(block->magic).store(kBlockMagic, std::memory_order_release);
+    next_page_++;
+    return block;
+}
+
+// mutex_ held. A sample or event block starting at first_ns, entered in the
+// index.
+BlockHeader* BlackBox::allocate_(BlockType type, uint16_t key, int64_t first_ns) {
+    BlockHeader* index = index_block_ ? block_(index_block_) : nullptr;
+    if (!index || index->count == kEntriesPerIndexBlock) {
+        // only start an index block if the block it is for fits as well
+        if (next_page_ + 1 >= pages_) {
+            mark_full_();
+            return nullptr;
+        }
+        BlockHeader* next = new_block_(BlockType::kIndex, 0);
+        reinterpret_cast<IndexBlock*>(next + 1)->prev = index_block_;
+        index_block_ = next_page_ - 1;
+        header_->index_page = index_block_;
+        index = next;
+    }
+    BlockHeader* block = new_block_(type, key);
+    if (!block) return nullptr;
+    block->first_ns = first_ns;
+
+    const uint32_t n = index->count;
+    index_entries(index)[n] = IndexEntry{static_cast<uint32_t>(next_page_ - 1), key, 0, first_ns};
+    if (n == 0) index->first_ns = first_ns;
+    index->last_ns = first_ns;
+    publish(index->count, n + 1);
+    return block;
+}
+
+void BlackBox::record_samples(const std::vector<sensor_datapoint>& samples) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (sealed_) return;
+    for (const auto& sd : samples) {
+        const uint16_t key = sample_key(sd.hat_id, sd.channel_id);
+        if (key >= sample_blocks_.size()) {
+            sample_blocks_.resize(key + 1, 0);
+        }
+        const int64_t time_ns = std::llround(sd.time * 1e6);
+        BlockHeader* block = sample_blocks_[key] ? block_(sample_blocks_[key]) : nullptr;
+        if (!block || block->count == kSamplesPerBlock) {
+            block = allocate_(BlockType::kSamples, key, time_ns);
+            if (!block) {
+                dropped_++;
+                continue;
+            }
+            sample_blocks_[key] = next_page_ - 1;
+        }
+        const uint32_t n = block->count;
+        sample_times(block)[n] = time_ns;
+        sample_values(block)[n] = sd.value;
+        if (n == 0) block->first_ns = time_ns;
+        block->last_ns = time_ns;
+        publish(block->count, n + 1);
+    }
+}
+
+// mutex_ held. The event body is a followed by b.
+void BlackBox::append_event_(EventKind kind, int64_t time_ns, const void* a, size_t a_len, const void* b,
+                             size_t b_len) {
+    if (sealed_) return;
+    const size_t size = event_size(a_len + b_len);
+    BlockHeader* block = event_block_ ? block_(event_block_) : nullptr;
+    if (!block || sizeof(BlockHeader) + block->used + size > kPageSize) {
+        block = allocate_(BlockType::kEvents, kEventsKey, time_ns);
+        if (!block) {
+            dropped_++;
+            return;
+        }
+        event_block_ = next_page_ - 1;
+    }
+    uint8_t* p = reinterpret_cast<uint8_t*>(block + 1) + block->used;
+    EventHeader event{static_cast<uint16_t>(kind), static_cast<uint16_t>(a_len + b_len), 0, time_ns};
+    std::memcpy(p, &event, sizeof(event));
+    std::memcpy(p + sizeof(event), a, a_len);
+    if (b_len) std::memcpy(p + sizeof(event) + a_len, b, b_len);
+    if (block->count == 0) block->first_ns = time_ns;
+    block->last_ns = time_ns;
+    publish(block->used, block->used + size);
+    publish(block->count, block->count + 1);
+}
+
+void BlackBox::record_command(std::string_view topic, std::string_view message) {
+    // an event has to fit in one block; longer commands are cut short
+    const size_t room = kPageSize - sizeof(BlockHeader) - sizeof(EventHeader) - sizeof(CommandEvent);
+    topic = topic.substr(0, 256);
+    message = message.substr(0, room - topic.size());
+
+    // topic and message go in one body; build it on the stack
+    uint8_t body[kPageSize];
+    CommandEvent command{static_cast<uint16_t>(topic.size())};
+    std::memcpy(body, &command, sizeof(command));
+    std::memcpy(body + sizeof(command), topic.data(), topic.size());
+    std::lock_guard<std::mutex> lock(mutex_);
+    append_event_(EventKind::kCommand, now_ns(), body, sizeof(command) + topic.size(), message.data(),
+                  message.size());
+}
+
+void BlackBox::record_relays(uint16_t bits) {
+    RelayEvent relay{bits};
+    std::lock_guard<std::mutex> lock(mutex_);
+    append_event_(EventKind::kRelay, now_ns(), &relay, sizeof(relay));
+}
+
+void BlackBox::record_servo(int id, uint16_t ticks, float position) {
+    ServoEvent servo{static_cast<uint16_t>(id), ticks, position};
+    std::lock_guard<std::mutex> lock(mutex_);
+    append_event_(EventKind::kServo, now_ns(), &servo, sizeof(servo));
+}
+
+void BlackBox::record_gpio(int pin, int value, uint64_t edge_ns) {
+    GpioEvent gpio{pin, value, edge_ns};
+    std::lock_guard<std::mutex> lock(mutex_);
+    append_event_(EventKind::kGpio, now_ns(), &gpio, sizeof(gpio));
+}
+
+void BlackBox::checkpoint() {
+    std::lock_guard<std::mutex> checkpoint_lock(checkpoint_mutex_);
+    size_t end, lowest_open;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        end = next_page_;
+        lowest_open = end;
+        for (size_t page : sample_blocks_) {
+            if (page) lowest_open = std::min(lowest_open, page);
+        }
+        if (event_block_) lowest_open = std::min(lowest_open, event_block_);
+        if (index_block_) lowest_open = std::min(lowest_open, index_block_);
+        header_->dropped = dropped_;
+    }
+
+    // msync wants addresses aligned to the system page, which may be larger
+    // than a block
+    static const size_t system_page = sysconf(_SC_PAGESIZE);
+    auto sync = [&](size_t from, size_t to) {
+        uintptr_t begin = reinterpret_cast<uintptr_t>(base_ + from * kPageSize) & ~(system_page - 1);
+        uintptr_t finish = reinterpret_cast<uintptr_t>(base_ + to * kPageSize);
+        if (finish > begin && msync(reinterpret_cast<void*>(begin), finish - begin, MS_SYNC) != 0) {
+            logging::warn(logging::Module::kMain, "Recording sync failed: {}", std::strerror(errno));
+        }
+    };
+    // blocks still being filled are synced again next time; the ones before
+    // them are complete and only need it once
+    sync(std::max<size_t>(synced_page_, 1), end);
+    synced_page_ = lowest_open;
+
+    header_->checkpoint_pages = end;
+    header_->checkpoint_ns = now_ns();
+    header_->checkpoints++;
+    sync(0, 1);
+}
+
+void BlackBox::checkpoint_func_(uint32_t period_ms) {
+    std::unique_lock<std::mutex> lock(stop_mutex_);
+    while (!stop_cv_.wait_for(lock, std::chrono::milliseconds(period_ms), [this] { return stop_; })) {
+        lock.unlock();
+        checkpoint();
+        lock.lock();
+    }
+}
+
+uint64_t BlackBox::dropped() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dropped_;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "recorder_settings.hpp"
+#include "recording_format.hpp"
+#include "state/state_store.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+class BlackBox {
+    // Local recording of every sample, command and actuator change, kept so
+    // a test survives losing the network. See recording_format.hpp for the
+    // layout.
+    //
+    // The file is preallocated and mapped once. Recording writes straight
+    // into the mapping under one mutex, with no syscall: each channel fills
+    // its own sample block in place and events share an event block. A
+    // checkpoint thread syncs the written pages every checkpoint_ms and then
+    // records how far the file is known to be on disk, so a power cut loses
+    // at most what was written since the last checkpoint. After a crash the
+    // file is still readable up to where writing stopped.
+  public:
+    // Creates <dir>/novaground-<run_id>.rec. Throws std::runtime_error if it
+    // can't be created or allocated.
+    BlackBox(const RecorderSettings& settings, uint64_t run_id);
+    // seal()s if that hasn't been done
+    ~BlackBox();
+
+    BlackBox(const BlackBox&) = delete;
+    BlackBox& operator=(const BlackBox&) = delete;
+
+    const std::string& path() const { return path_; }
+
+    // One sampling pass
+    void record_samples(const std::vector<sensor_datapoint>& samples);
+    void record_command(std::string_view topic, std::string_view message);
+    void record_relays(uint16_t bits);
+    void record_servo(int id, uint16_t ticks, float position);
+    void record_gpio(int pin, int value, uint64_t edge_ns);
+
+    // Syncs everything recorded so far; also run by the checkpoint thread
+    void checkpoint();
+    // Stops recording (later calls are ignored), takes a final checkpoint,
+    // marks the file closed and trims the unused tail. For shutting down
+    // while other threads may still be recording.
+    void seal();
+
+    uint64_t dropped() const;
+
+  private:
+    recording::BlockHeader* allocate_(recording::BlockType type, uint16_t key, int64_t first_ns);
+    recording::BlockHeader* new_block_(recording::BlockType type, uint16_t key);
+    void mark_full_();
+    void append_event_(recording::EventKind kind, int64_t time_ns, const void* a, size_t a_len,
+                       const void* b = nullptr, size_t b_len = 0);
+    recording::BlockHeader* block_(size_t page) const;
+    void checkpoint_func_(uint32_t period_ms);
+
+    std::string path_;
+    int fd_ = -1;
+    uint8_t* base_ = nullptr;
+    size_t pages_ = 0;
+    recording::FileHeader* header_ = nullptr;
+
+    mutable std::mutex mutex_;
+    size_t next_page_ = 1;
+    std::vector<size_t> sample_blocks_;  // open block page by key, 0 = none
+    size_t event_block_ = 0;
+    size_t index_block_ = 0;
+    bool full_ = false;
+    bool sealed_ = false;
+    uint64_t dropped_ = 0;
+
+    std::mutex checkpoint_mutex_;        // one checkpoint at a time
+    size_t synced_page_ = 0;             // pages before this one are on disk and won't change
+
+    std::mutex stop_mutex_;
+    std::condition_variable stop_cv_;
+    bool stop_ = false;
+    std::thread checkpointer_;
+};
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+struct RecorderSettings {
+    std::string dir;               // empty = no recording; one file per run in here
+    uint32_t size_mb = 1024;       // preallocated; recording stops when full
+    uint32_t checkpoint_ms = 100;  // how often the file is synced to disk
+
+    bool operator==(const RecorderSettings&) const = default;
+};
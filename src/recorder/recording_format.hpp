@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// On-disk layout of a black-box recording (BlackBox writes it,
+// RecordingReader reads it).
+//
+// The file is preallocated and divided into pages. Page 0 is the FileHeader;
+// every page after it is one block. Blocks are allocated in file order, and
+// the header of a new block is written when the block is allocated, so the
+// used part of the file is contiguous: it ends at the first page without the
+// block magic.
+//
+// A sample block holds up to kSamplesPerBlock samples of one channel, in
+// columns: all the timestamps, then all the values. An event block holds
+// variable-length events (commands, relay, servo and GPIO changes) in the
+// order they happened. In both, count is stored after the data it covers, so
+// a block is valid up to count even if the writer stopped halfway.
+//
+// Index blocks make the file searchable by time without reading it: every
+// sample and event block gets an IndexEntry (its page, channel and first
+// timestamp) when it is allocated. Index blocks are chained newest to oldest
+// through IndexBlock::prev, and FileHeader::index_page points at the newest
+// one as of the last checkpoint. A channel's blocks, and its entries, are in
+// time order, so a reader can binary-search the entries for a window and
+// then the timestamps inside the few blocks it covers. Blocks written after
+// the last checkpoint may be missing from the chain; readers find them by
+// looking past checkpoint_pages.
+//
+// All integers are little-endian; times are ns since the Unix epoch unless
+// noted.
+
+namespace recording {
+
+constexpr size_t kPageSize = 4096;
+constexpr uint64_t kFileMagic = 0x3143455242474e4eULL; // "NNGBREC1"
+constexpr uint32_t kBlockMagic = 0x4b4c4247;           // "GBLK"
+constexpr uint32_t kVersion = 1;
+
+struct FileHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t page_size;
+    uint64_t file_bytes;      // preallocated size
+    uint64_t run_id;          // as in the telemetry "run" field
+    int64_t created_ns;
+    // rewritten at every checkpoint; everything before checkpoint_pages was
+    // on disk when checkpoint_ns was taken
+    uint64_t checkpoint_pages;
+    int64_t checkpoint_ns;
+    uint64_t checkpoints;
+    uint64_t dropped;         // samples and events lost because the file was full
+    uint8_t closed;           // 1 after a clean shutdown
+    uint8_t reserved[7];
+    uint64_t index_page;      // newest index block, 0 = none (files from before the index)
+};
+
+enum class BlockType : uint16_t { kSamples = 1, kEvents = 2, kIndex = 3 };
+
+struct BlockHeader {
+    uint32_t magic;
+    uint16_t type;            // BlockType
+    uint16_t key;             // sample blocks: hat * 8 + channel
+    uint32_t count;           // samples or events
+    uint32_t used;            // event blocks: payload bytes after the header
+    int64_t first_ns;         // time of the first and last entry
+    int64_t last_ns;
+};
+static_assert(sizeof(BlockHeader) == 32);
+
+constexpr size_t kSamplesPerBlock = (kPageSize - sizeof(BlockHeader)) / (sizeof(int64_t) + sizeof(double));
+
+inline uint16_t sample_key(int hat_id, int channel_id) { return static_cast<uint16_t>(hat_id * 8 + channel_id); }
+inline int key_hat(uint16_t key) { return key / 8; }
+inline int key_channel(uint16_t key) { return key % 8; }
+
+// A sample block's columns
+inline const int64_t* sample_times(const BlockHeader* block) {
+    return reinterpret_cast<const int64_t*>(block + 1);
+}
+inline const double* sample_values(const BlockHeader* block) {
+    return reinterpret_cast<const double*>(sample_times(block) + kSamplesPerBlock);
+}
+inline int64_t* sample_times(BlockHeader* block) { return reinterpret_cast<int64_t*>(block + 1); }
+inline double* sample_values(BlockHeader* block) {
+    return reinterpret_cast<double*>(sample_times(block) + kSamplesPerBlock);
+}
+
+// An index block is a BlockHeader (count = entries), this, then the entries
+struct IndexBlock {
+    uint64_t prev;            // previous index block, 0 for the first
+};
+
+struct IndexEntry {
+    uint32_t page;
+    uint16_t key;             // sample_key(), or kEventsKey for an event block
+    uint16_t reserved;
+    int64_t first_ns;
+};
+static_assert(sizeof(IndexEntry) == 16);
+
+constexpr uint16_t kEventsKey = 0xffff;
+constexpr size_t kEntriesPerIndexBlock =
+    (kPageSize - sizeof(BlockHeader) - sizeof(IndexBlock)) / sizeof(IndexEntry);
+
+inline const IndexEntry* index_entries(const BlockHeader* block) {
+    return reinterpret_cast<const IndexEntry*>(reinterpret_cast<const IndexBlock*>(block + 1) + 1);
+}
+inline IndexEntry* index_entries(BlockHeader* block) {
+    return reinterpret_cast<IndexEntry*>(reinterpret_cast<IndexBlock*>(block + 1) + 1);
+}
+
+enum class EventKind : uint16_t { kCommand = 1, kRelay = 2, kServo = 3, kGpio = 4 };
+
+// Each event is this header, then length bytes, padded to 8
+struct EventHeader {
+    uint16_t kind;            // EventKind
+    uint16_t length;
+    uint32_t reserved;
+    int64_t time_ns;
+};
+static_assert(sizeof(EventHeader) == 16);
+
+// kCommand: topic_length bytes of topic, then the message
+struct CommandEvent {
+    uint16_t topic_length;
+};
+
+struct RelayEvent {
+    uint16_t bits;            // bit n = relay n
+};
+
+struct ServoEvent {
+    uint16_t id;
+    uint16_t ticks;           // PCA9685 OFF tick
+    float position;           // in the servo's calibrated units
+};
+
+struct GpioEvent {
+    int32_t pin;
+    int32_t value;
+    uint64_t edge_ns;         // kernel edge timestamp, in the configured event clock
+};
+
+inline size_t event_size(size_t length) { return (sizeof(EventHeader) + length + 7) & ~size_t{7}; }
+
+} // namespace recording
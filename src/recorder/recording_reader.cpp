@@ -0,0 +1,167 @@
+#include "recording_reader.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace recording;
+
+RecordingReader::RecordingReader(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("cannot open " + path + ": " + std::strerror(errno));
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < kPageSize) {
+        close(fd);
+        throw std::runtime_error(path + " is not a recording");
+    }
+    bytes_ = st.st_size - st.st_size % kPageSize;
+    void* base = mmap(nullptr, bytes_, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        throw std::runtime_error("cannot map " + path + ": " + std::strerror(errno));
+    }
+    base_ = static_cast<const uint8_t*>(base);
+    header_ = reinterpret_cast<const FileHeader*>(base_);
+    if (header_->magic != kFileMagic || header_->version != kVersion || header_->page_size != kPageSize) {
+        munmap(const_cast<uint8_t*>(base_), bytes_);
+        throw std::runtime_error(path + " is not a recording this build can read");
+    }
+
+    // blocks before the last checkpoint are known to be there; look past it
+    // for ones written after
+    const size_t pages = bytes_ / kPageSize;
+    end_ = std::clamp<size_t>(header_->checkpoint_pages, 1, pages);
+    while (end_ < pages && reinterpret_cast<const BlockHeader*>(base_ + end_ * kPageSize)->magic == kBlockMagic) {
+        end_++;
+    }
+    build_index_();
+}
+
+void RecordingReader::build_index_() {
+    std::vector<bool> indexed(end_, false);
+    auto add = [&](uint32_t page, uint16_t key, int64_t first_ns) {
+        if (page == 0 || page >= end_ || indexed[page]) return;
+        const BlockHeader& b = block(page);
+        if (b.magic != kBlockMagic || b.key != key || b.count == 0) return;
+        indexed[page] = true;
+        index_[key].push_back({first_ns, page});
+    };
+
+    // Blocks from after the last checkpoint may not be in the chain that
+    // was synced, and a newer index block may be among them. A file without
+    // an index is scanned whole.
+    size_t newest_index = header_->index_page < end_ ? header_->index_page : 0;
+    const size_t tail = newest_index ? std::clamp<size_t>(header_->checkpoint_pages, 1, end_) : 1;
+    std::vector<size_t> unindexed;
+    for (size_t page = tail; page < end_; page++) {
+        if (block(page).type == static_cast<uint16_t>(BlockType::kIndex)) {
+            newest_index = std::max(newest_index, page);
+        } else {
+            unindexed.push_back(page);
+        }
+    }
+
+    for (size_t page = newest_index; page;) {
+        const BlockHeader& b = block(page);
+        if (b.type != static_cast<uint16_t>(BlockType::kIndex)) break;
+        const IndexEntry* entries = index_entries(&b);
+        for (size_t i = 0; i < std::min<size_t>(b.count, kEntriesPerIndexBlock); i++) {
+            add(entries[i].page, entries[i].key, entries[i].first_ns);
+        }
+        const uint64_t prev = reinterpret_cast<const IndexBlock*>(&b + 1)->prev;
+        page = prev < page ? prev : 0; // the chain only ever points back
+    }
+
+    for (size_t page : unindexed) {
+        const BlockHeader& b = block(page);
+        if (b.type == static_cast<uint16_t>(BlockType::kSamples) || b.type == static_cast<uint16_t>(BlockType::kEvents)) {
+            add(page, b.key, b.first_ns);
+        }
+    }
+    for (auto& [key, refs] : index_) {
+        std::sort(refs.begin(), refs.end(), [](const BlockRef& a, const BlockRef& b) { return a.page < b.page; });
+    }
+}
+
+std::vector<uint16_t> RecordingReader::channels() const {
+    std::vector<uint16_t> keys;
+    for (const auto& [key, refs] : index_) {
+        if (key != kEventsKey) keys.push_back(key);
+    }
+    return keys;
+}
+
+const std::vector<RecordingReader::BlockRef>& RecordingReader::blocks(uint16_t key) const {
+    static const std::vector<BlockRef> none;
+    auto it = index_.find(key);
+    return it == index_.end() ? none : it->second;
+}
+
+std::vector<RecordingReader::BlockRef>::const_iterator RecordingReader::first_block_(
+    const std::vector<BlockRef>& refs, int64_t from_ns) const {
+    // the last block starting at or before from_ns, which may still run past it
+    auto it = std::upper_bound(refs.begin(), refs.end(), from_ns,
+                               [](int64_t t, const BlockRef& ref) { return t < ref.first_ns; });
+    return it == refs.begin() ? it : it - 1;
+}
+
+size_t RecordingReader::query(uint16_t key, int64_t from_ns, int64_t to_ns, std::vector<int64_t>& times,
+                              std::vector<double>& values) const {
+    const std::vector<BlockRef>& refs = blocks(key);
+    size_t added = 0;
+    for (auto it = first_block_(refs, from_ns); it != refs.end() && it->first_ns <= to_ns; ++it) {
+        const BlockHeader& b = block(it->page);
+        const int64_t* t = sample_times(&b);
+        const double* v = sample_values(&b);
+        const size_t n = sample_count(b);
+        const size_t lo = std::lower_bound(t, t + n, from_ns) - t;
+        const size_t hi = std::upper_bound(t, t + n, to_ns) - t;
+        if (lo >= hi) continue;
+        times.insert(times.end(), t + lo, t + hi);
+        values.insert(values.end(), v + lo, v + hi);
+        added += hi - lo;
+    }
+    return added;
+}
+
+void RecordingReader::query_events(int64_t from_ns, int64_t to_ns, const std::function<void(const Event&)>& fn) const {
+    const std::vector<BlockRef>& refs = blocks(kEventsKey);
+    for (auto it = first_block_(refs, from_ns); it != refs.end() && it->first_ns <= to_ns; ++it) {
+        for_each_event(block(it->page), [&](const Event& event) {
+            if (event.time_ns >= from_ns && event.time_ns <= to_ns) fn(event);
+        });
+    }
+}
+
+RecordingReader::~RecordingReader() {
+    munmap(const_cast<uint8_t*>(base_), bytes_);
+}
+
+const BlockHeader& RecordingReader::block(size_t index) const {
+    return *reinterpret_cast<const BlockHeader*>(base_ + index * kPageSize);
+}
+
+size_t RecordingReader::sample_count(const BlockHeader& block) {
+    return std::min<size_t>(block.count, kSamplesPerBlock);
+}
+
+void RecordingReader::for_each_event(const BlockHeader& block, const std::function<void(const Event&)>& fn) const {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(&block + 1);
+    const size_t used = std::min<size_t>(block.used, kPageSize - sizeof(BlockHeader));
+    size_t offset = 0;
+    for (uint32_t i = 0; i < block.count && offset + sizeof(EventHeader) <= used; i++) {
+        EventHeader event;
+        std::memcpy(&event, p + offset, sizeof(event));
+        if (offset + event_size(event.length) > used) break;
+        fn(Event{static_cast<EventKind>(event.kind), event.time_ns,
+                 std::string_view(reinterpret_cast<const char*>(p + offset + sizeof(event)), event.length)});
+        offset += event_size(event.length);
+    }
+}
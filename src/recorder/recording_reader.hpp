@@ -0,0 +1,76 @@
+#pragma once
+
+#include "recording_format.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class RecordingReader {
+    // Read-only view of a recording, finished or not. The file is mapped, so
+    // only the blocks that are looked at are read from disk.
+    //
+    // A recording cut short by a crash or power cut is read up to where
+    // writing stopped: the last block is the one before the first page
+    // without a block header, and each block holds count entries.
+    //
+    // Opening reads the index chain (one page per kEntriesPerIndexBlock
+    // blocks) and whatever was written after the last checkpoint, and keeps
+    // each channel's blocks in time order. A time window is then found by
+    // binary search, first over the blocks, then inside the ones it covers.
+  public:
+    // Throws std::runtime_error if the file can't be opened or isn't a
+    // recording
+    explicit RecordingReader(const std::string& path);
+    ~RecordingReader();
+
+    RecordingReader(const RecordingReader&) = delete;
+    RecordingReader& operator=(const RecordingReader&) = delete;
+
+    const recording::FileHeader& header() const { return *header_; }
+    // Blocks are numbered by the page they sit on, from 1 up to (not
+    // including) end_block()
+    size_t end_block() const { return end_; }
+    const recording::BlockHeader& block(size_t index) const;
+    // Samples held by a sample block, clamped to what a block can hold
+    static size_t sample_count(const recording::BlockHeader& block);
+
+    // Events of an event block, oldest first
+    struct Event {
+        recording::EventKind kind;
+        int64_t time_ns;
+        std::string_view body;
+    };
+    void for_each_event(const recording::BlockHeader& block, const std::function<void(const Event&)>& fn) const;
+
+    struct BlockRef {
+        int64_t first_ns;
+        uint32_t page;
+    };
+    // Recorded channels (sample_key()), ascending
+    std::vector<uint16_t> channels() const;
+    // One channel's blocks, or the event blocks for kEventsKey, in time order
+    const std::vector<BlockRef>& blocks(uint16_t key) const;
+
+    // Appends the samples of one channel with from_ns <= time <= to_ns to
+    // times and values, in time order. Returns how many there were.
+    size_t query(uint16_t key, int64_t from_ns, int64_t to_ns, std::vector<int64_t>& times,
+                 std::vector<double>& values) const;
+    // Events with from_ns <= time <= to_ns, in time order
+    void query_events(int64_t from_ns, int64_t to_ns, const std::function<void(const Event&)>& fn) const;
+
+  private:
+    const uint8_t* base_ = nullptr;
+    size_t bytes_ = 0;
+    const recording::FileHeader* header_ = nullptr;
+    size_t end_ = 1;
+    std::map<uint16_t, std::vector<BlockRef>> index_;
+
+    void build_index_();
+    // first block that can hold time from_ns
+    std::vector<BlockRef>::const_iterator first_block_(const std::vector<BlockRef>& refs, int64_t from_ns) const;
+};
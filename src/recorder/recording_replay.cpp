@@ -0,0 +1,144 @@
+#include "recording_replay.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <thread>
+#include <utility>
+
+using namespace recording;
+
+namespace {
+
+// Position in one channel's blocks
+struct Cursor {
+    const std::vector<RecordingReader::BlockRef>* refs;
+    size_t block = 0;
+    const BlockHeader* header = nullptr;
+    size_t count = 0;
+    size_t sample = 0;
+
+    int64_t time() const { return sample_times(header)[sample]; }
+    double value() const { return sample_values(header)[sample]; }
+};
+
+struct PendingGpio {
+    int64_t time_ns;
+    GpioEvent event;
+};
+
+} // namespace
+
+RecordingReplay::RecordingReplay(const std::string& path, double speed)
+    : path_(path), reader_(path), speed_(speed > 0 ? speed : 0) {}
+
+void RecordingReplay::run(const SampleSink& samples, const GpioSink& gpio) {
+    // next non-empty block at or after cursor.block
+    auto load = [this](Cursor& cursor) {
+        for (; cursor.block < cursor.refs->size(); cursor.block++) {
+            cursor.header = &reader_.block((*cursor.refs)[cursor.block].page);
+            cursor.count = RecordingReader::sample_count(*cursor.header);
+            cursor.sample = 0;
+            if (cursor.count) return true;
+        }
+        return false;
+    };
+
+    // channels merged by time: (time of the next sample, cursor)
+    std::vector<Cursor> cursors;
+    std::vector<uint16_t> keys;
+    for (uint16_t key : reader_.channels()) {
+        if (key >= 64) continue; // not a hat:channel
+        Cursor cursor{&reader_.blocks(key)};
+        if (load(cursor)) {
+            cursors.push_back(cursor);
+            keys.push_back(key);
+        }
+    }
+    using Next = std::pair<int64_t, size_t>;
+    std::priority_queue<Next, std::vector<Next>, std::greater<Next>> next;
+    for (size_t i = 0; i < cursors.size(); i++) {
+        next.push({cursors[i].time(), i});
+    }
+
+    // GPIO events, one event block at a time
+    const auto& event_blocks = reader_.blocks(kEventsKey);
+    size_t event_block = 0;
+    std::vector<PendingGpio> events;
+    size_t event = 0;
+    auto have_event = [&] {
+        while (event == events.size() && event_block < event_blocks.size()) {
+            events.clear();
+            event = 0;
+            reader_.for_each_event(reader_.block(event_blocks[event_block++].page),
+                                   [&](const RecordingReader::Event& e) {
+                                       if (e.kind != EventKind::kGpio || e.body.size() < sizeof(GpioEvent)) return;
+                                       PendingGpio pending{e.time_ns, {}};
+                                       std::memcpy(&pending.event, e.body.data(), sizeof(GpioEvent));
+                                       events.push_back(pending);
+                                   });
+        }
+        return event < events.size();
+    };
+
+    if (next.empty() && !have_event()) return;
+    int64_t first_ns = next.empty() ? events[event].time_ns : next.top().first;
+    if (have_event()) first_ns = std::min(first_ns, events[event].time_ns);
+
+    const auto start = std::chrono::steady_clock::now();
+    const int64_t start_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                 std::chrono::system_clock::now().time_since_epoch())
+                                 .count();
+    const double stretch = speed_ > 0 ? 1 / speed_ : 1;
+    // when a recorded time comes round in the replay, ns since start
+    auto offset = [&](int64_t time_ns) { return static_cast<int64_t>((time_ns - first_ns) * stretch); };
+    auto wait_for = [&](int64_t time_ns) {
+        if (speed_ > 0) std::this_thread::sleep_until(start + std::chrono::nanoseconds(offset(time_ns)));
+    };
+
+    // the pass being rebuilt, with its samples' recorded times
+    std::vector<sensor_datapoint> pass;
+    std::vector<int64_t> pass_times;
+    uint64_t in_pass = 0; // bit n = key n
+    auto flush = [&] {
+        if (pass.empty()) return;
+        for (size_t i = 0; i < pass.size(); i++) {
+            pass[i].time = (start_ns + offset(pass_times[i])) / 1e6;
+        }
+        wait_for(pass_times.back());
+        samples(pass);
+        passes_++;
+        pass.clear();
+        pass_times.clear();
+        in_pass = 0;
+    };
+
+    while (!next.empty() || have_event()) {
+        if (have_event() && (next.empty() || events[event].time_ns <= next.top().first)) {
+            // an edge in the middle of a pass goes out on its own; the pass
+            // is only published once complete, as sample_once() does
+            const PendingGpio& pending = events[event++];
+            wait_for(pending.time_ns);
+            gpio(GPIO_Event{pending.event.pin, pending.event.value,
+                            static_cast<uint64_t>(start_ns + offset(pending.time_ns))});
+            gpio_events_++;
+            continue;
+        }
+
+        const size_t i = next.top().second;
+        next.pop();
+        Cursor& cursor = cursors[i];
+        const uint16_t key = keys[i];
+        if (in_pass >> key & 1) flush();
+        pass.push_back({key_hat(key), key_channel(key), cursor.value(), 0});
+        pass_times.push_back(cursor.time());
+        in_pass |= uint64_t{1} << key;
+
+        if (++cursor.sample < cursor.count || (cursor.block++, load(cursor))) {
+            next.push({cursor.time(), i});
+        }
+    }
+    flush();
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "recording_reader.hpp"
+#include "interfaces/gpio_backend.hpp"
+#include "state/state_store.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+class RecordingReplay {
+    // Plays a recording back as if it were coming from the hardware: the
+    // sampling passes and GPIO input edges, merged in time order and paced
+    // like the original run. Commands and actuator changes in the recording
+    // are outputs of that run and are not replayed.
+    //
+    // A pass is rebuilt by taking samples of all channels in time order until
+    // a channel comes round again, which is how sample_once() read them, and
+    // is delivered whole; edges that fell inside it are delivered at their
+    // own time without splitting it.
+    // Timestamps are moved to the replay: at 1x and Nx they are the wall
+    // clock time each sample is delivered (so spacing shrinks by N); as fast
+    // as possible they keep the recorded spacing from the start of the replay.
+  public:
+    // speed: 1 = real time, N = N times faster, 0 = as fast as possible.
+    // Throws std::runtime_error if the file isn't a recording.
+    RecordingReplay(const std::string& path, double speed);
+
+    using SampleSink = std::function<void(const std::vector<sensor_datapoint>&)>;
+    // timestamp_ns is on the system clock
+    using GpioSink = std::function<void(const GPIO_Event&)>;
+
+    // Feeds the whole recording, blocking until it has been played
+    void run(const SampleSink& samples, const GpioSink& gpio);
+
+    const std::string& path() const { return path_; }
+    double speed() const { return speed_; }
+    uint64_t passes() const { return passes_; }
+    uint64_t gpio_events() const { return gpio_events_; }
+
+  private:
+    std::string path_;
+    RecordingReader reader_;
+    double speed_;
+    uint64_t passes_ = 0;
+    uint64_t gpio_events_ = 0;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "recording_format.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <string>
+#include <vector>
+
+// Command-line helpers shared by the recording tools (novaground-query,
+// novaground-export): picking channels and turning a window given in
+// seconds around t0 into recording timestamps.
+
+namespace recording {
+
+// "HAT:CH[,HAT:CH...]" as sample keys, in the order given; a channel listed
+// twice is kept once. False on a malformed entry, which is left in bad.
+inline bool parse_channels(const std::string& list, std::vector<uint16_t>& keys, std::string& bad) {
+    keys.clear();
+    size_t start = 0;
+    while (start < list.size()) {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos) end = list.size();
+        const std::string entry = list.substr(start, end - start);
+        int hat, channel;
+        if (std::sscanf(entry.c_str(), "%d:%d", &hat, &channel) != 2 || hat < 0 || hat > 7 || channel < 0 ||
+            channel > 7) {
+            bad = entry;
+            return false;
+        }
+        const uint16_t key = sample_key(hat, channel);
+        if (std::find(keys.begin(), keys.end(), key) == keys.end()) keys.push_back(key);
+        start = end + 1;
+    }
+    return true;
+}
+
+// t0_ns + seconds, clamped so open-ended (infinite) windows don't overflow
+inline int64_t window_ns(int64_t t0_ns, double seconds) {
+    double ns = t0_ns + seconds * 1e9;
+    return ns <= -9.2e18 ? std::numeric_limits<int64_t>::min()
+         : ns >= 9.2e18  ? std::numeric_limits<int64_t>::max()
+                         : static_cast<int64_t>(ns);
+}
+
+} // namespace recording
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+struct SpoolSettings {
+    std::string dir;                // empty = no spool, frames are dropped while offline
+    uint32_t segment_mb = 8;
+    uint32_t segments = 16;         // the ring holds segment_mb * segments
+    uint32_t catch_up_per_s = 1000; // replayed frames per second after reconnect
+
+    bool operator==(const SpoolSettings&) const = default;
+};
@@ -0,0 +1,54 @@
+#include "telemetry_history.hpp"
+
+#include <algorithm>
+
+TelemetryHistory::TelemetryHistory(size_t capacity) : slots_(std::max<size_t>(capacity, 1)) {}
+
+void TelemetryHistory::set_capacity(size_t capacity) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    slots_.assign(std::max<size_t>(capacity, 1), Slot{});
+    newest_ = 0;
+}
+
+uint64_t TelemetryHistory::next_seq() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return next_++;
+}
+
+void TelemetryHistory::record(uint64_t seq, const std::string& payload) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Slot& slot = slots_[seq % slots_.size()];
+    slot.seq = seq;
+    slot.payload.assign(payload);
+    newest_ = std::max(newest_, seq);
+}
+
+size_t TelemetryHistory::range(uint64_t from, uint64_t to, const Visitor& fn) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (newest_ == 0) return 0;
+    from = std::max(from, newest_ >= slots_.size() ? newest_ - slots_.size() + 1 : 1);
+    to = std::min(to, newest_);
+    size_t count = 0;
+    for (uint64_t seq = from; seq <= to; seq++) {
+        const Slot& slot = slots_[seq % slots_.size()];
+        if (slot.seq != seq) continue; // taken but never recorded
+        fn(seq, slot.payload);
+        count++;
+    }
+    return count;
+}
+
+uint64_t TelemetryHistory::oldest() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (newest_ == 0) return 0;
+    uint64_t first = newest_ >= slots_.size() ? newest_ - slots_.size() + 1 : 1;
+    for (uint64_t seq = first; seq <= newest_; seq++) {
+        if (slots_[seq % slots_.size()].seq == seq) return seq;
+    }
+    return 0;
+}
+
+uint64_t TelemetryHistory::newest() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return newest_;
+}
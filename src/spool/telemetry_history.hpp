@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class TelemetryHistory {
+    // The last capacity frames of one telemetry stream, by sequence number,
+    // kept so a subscriber that noticed a gap can ask for the missing range.
+    //
+    // Sequence numbers start at 1 and increase by one per frame. A single
+    // thread produces each stream: it takes the next number, builds the
+    // payload with it and records it. Slots keep their string buffers, so
+    // once the ring has gone round recording doesn't allocate.
+  public:
+    explicit TelemetryHistory(size_t capacity = 2000);
+
+    // Drops everything held. Call before the producer starts.
+    void set_capacity(size_t capacity);
+
+    uint64_t next_seq();
+    void record(uint64_t seq, const std::string& payload);
+
+    // Calls fn for each held frame with from <= seq <= to, oldest first.
+    // Returns how many there were.
+    using Visitor = std::function<void(uint64_t seq, const std::string& payload)>;
+    size_t range(uint64_t from, uint64_t to, const Visitor& fn) const;
+
+    // Oldest and newest held sequence numbers, 0 if empty
+    uint64_t oldest() const;
+    uint64_t newest() const;
+
+  private:
+    struct Slot {
+        uint64_t seq = 0;
+        std::string payload;
+    };
+
+    mutable std::mutex mutex_;
+    std::vector<Slot> slots_;
+    uint64_t next_ = 1;
+    uint64_t newest_ = 0;
+};
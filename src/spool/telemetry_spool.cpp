@@ -0,0 +1,280 @@
+#include "telemetry_spool.hpp"
+
+#include "logging/log.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint32_t kSegmentMagic = 0x5053474e; // "NGSP"
+constexpr uint32_t kFrameMagic = 0x4d52464e;   // "NFRM"
+constexpr uint32_t kVersion = 1;
+
+struct FrameHeader {
+    uint32_t magic;
+    uint32_t topic_len;
+    uint32_t payload_len;
+    uint32_t reserved;
+};
+
+size_t frame_size(size_t topic_len, size_t payload_len) {
+    return (sizeof(FrameHeader) + topic_len + payload_len + 7) & ~size_t{7};
+}
+
+std::runtime_error spool_error(const std::string& what, const std::string& path) {
+    return std::runtime_error("spool: " + what + " " + path + ": " + std::strerror(errno));
+}
+
+} // namespace
+
+struct TelemetrySpool::SegmentHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t segment_bytes;
+    uint64_t generation; // order of reuse, 0 = never written
+    uint64_t write_end;  // offset past the last complete frame
+    uint64_t read_pos;   // offset of the first frame not yet replayed
+    uint8_t reserved[24];
+};
+
+static_assert(sizeof(FrameHeader) % 8 == 0);
+
+namespace {
+
+// Header offsets are stored after the data they cover, so they must not be
+// reordered ahead of it
+uint64_t load(const uint64_t& field) {
+    return std::atomic_ref<const uint64_t>(field).load(std::memory_order_acquire);
+}
+void store(uint64_t& field, uint64_t value) {
+    std::atomic_ref<uint64_t>(field).store(value, std::memory_order_release);
+}
+
+} // namespace
+
+TelemetrySpool::TelemetrySpool(const SpoolSettings& settings)
+    : segment_bytes_(size_t{settings.segment_mb} << 20) {
+    if (settings.dir.empty() || settings.segments < 2 || segment_bytes_ < 2 * sizeof(SegmentHeader)) {
+        throw std::runtime_error("spool: needs a directory, two or more segments and a nonzero size");
+    }
+    if (mkdir(settings.dir.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw spool_error("cannot create", settings.dir);
+    }
+
+    for (uint32_t i = 0; i < settings.segments; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "/segment-%03u.spool", i);
+        const std::string path = settings.dir + name;
+
+        int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw spool_error("cannot open", path);
+        }
+        struct stat st;
+        bool reuse = fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) == segment_bytes_;
+        // allocate the blocks now so a full disk shows up here, not as
+        // SIGBUS on a later append
+        if (!reuse) {
+            int err = ftruncate(fd, 0) != 0 ? errno : posix_fallocate(fd, 0, segment_bytes_);
+            if (err) {
+                close(fd);
+                errno = err;
+                throw spool_error("cannot allocate", path);
+            }
+        }
+        void* base = mmap(nullptr, segment_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED) {
+            throw spool_error("cannot map", path);
+        }
+        segments_.push_back({static_cast<uint8_t*>(base), static_cast<SegmentHeader*>(base)});
+
+        const SegmentHeader& h = *segments_.back().header;
+        bool valid = reuse && h.magic == kSegmentMagic && h.version == kVersion &&
+                     h.segment_bytes == segment_bytes_ && h.read_pos >= sizeof(SegmentHeader) &&
+                     h.read_pos <= h.write_end && h.write_end <= segment_bytes_;
+        if (!valid) {
+            reset_(i);
+            segments_.back().header->generation = 0;
+        }
+    }
+
+    // pick up a ring left by an earlier run: append after the newest
+    // segment, replay from the oldest one that still has frames
+    uint64_t oldest = UINT64_MAX;
+    generation_ = 0;
+    read_ = SIZE_MAX;
+    for (size_t i = 0; i < segments_.size(); i++) {
+        const SegmentHeader& h = *segments_[i].header;
+        if (h.generation > generation_) {
+            generation_ = h.generation;
+            write_ = i;
+        }
+        if (h.generation && !drained_(i) && h.generation < oldest) {
+            oldest = h.generation;
+            read_ = i;
+        }
+    }
+    if (generation_ == 0) {
+        reset_(0);
+        write_ = 0;
+    }
+    if (read_ == SIZE_MAX) {
+        read_ = write_;
+    }
+    if (!empty()) {
+        logging::info(logging::Module::kMqtt, "Spool holds {} bytes of telemetry from an earlier run",
+                      pending_bytes());
+    }
+}
+
+TelemetrySpool::~TelemetrySpool() {
+    for (const Segment& s : segments_) {
+        munmap(s.base, segment_bytes_);
+    }
+}
+
+void TelemetrySpool::reset_(size_t index) {
+    SegmentHeader& h = *segments_[index].header;
+    h.magic = kSegmentMagic;
+    h.version = kVersion;
+    h.segment_bytes = segment_bytes_;
+    h.generation = ++generation_;
+    store(h.read_pos, sizeof(SegmentHeader));
+    store(h.write_end, sizeof(SegmentHeader));
+}
+
+bool TelemetrySpool::drained_(size_t index) const {
+    const SegmentHeader& h = *segments_[index].header;
+    return load(h.read_pos) >= load(h.write_end);
+}
+
+// Moves on to the next segment. If that is the oldest one still holding
+// frames, they are overwritten.
+void TelemetrySpool::advance_write_() {
+    write_ = (write_ + 1) % segments_.size();
+    if (write_ == read_ && !drained_(read_)) {
+        const Segment& s = segments_[read_];
+        uint64_t lost = 0;
+        for (uint64_t pos = load(s.header->read_pos); pos < load(s.header->write_end);) {
+            const auto* f = reinterpret_cast<const FrameHeader*>(s.base + pos);
+            pos += frame_size(f->topic_len, f->payload_len);
+            lost++;
+        }
+        dropped_ += lost;
+        logging::warn(logging::Module::kMqtt, "Spool full, dropped {} oldest telemetry frames", lost);
+    }
+    reset_(write_);
+    if (write_ == read_) {
+        // everything older is gone; the oldest frames left are in the next one
+        read_ = (write_ + 1) % segments_.size();
+        while (read_ != write_ && drained_(read_)) {
+            read_ = (read_ + 1) % segments_.size();
+        }
+    }
+}
+
+bool TelemetrySpool::append(std::string_view topic, std::string_view payload) {
+    const size_t size = frame_size(topic.size(), payload.size());
+    if (size > segment_bytes_ - sizeof(SegmentHeader)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (load(segments_[write_].header->write_end) + size > segment_bytes_) {
+        advance_write_();
+    }
+    const Segment& s = segments_[write_];
+    const uint64_t end = load(s.header->write_end);
+    uint8_t* p = s.base + end;
+    FrameHeader f{kFrameMagic, static_cast<uint32_t>(topic.size()), static_cast<uint32_t>(payload.size()), 0};
+    std::memcpy(p, &f, sizeof(f));
+    std::memcpy(p + sizeof(f), topic.data(), topic.size());
+    std::memcpy(p + sizeof(f) + topic.size(), payload.data(), payload.size());
+    store(s.header->write_end, end + size);
+    return true;
+}
+
+size_t TelemetrySpool::replay(size_t max_frames, const Sender& send) {
+    std::vector<Frame> frames;
+    std::vector<FrameEnd> ends;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        while (read_ != write_ && drained_(read_)) {
+            read_ = (read_ + 1) % segments_.size();
+        }
+        size_t index = read_;
+        uint64_t pos = load(segments_[index].header->read_pos);
+        while (frames.size() < max_frames) {
+            const Segment& s = segments_[index];
+            const uint64_t end = load(s.header->write_end);
+            if (pos >= end) {
+                if (index == write_) break;
+                index = (index + 1) % segments_.size();
+                pos = load(segments_[index].header->read_pos);
+                continue;
+            }
+            const auto* f = reinterpret_cast<const FrameHeader*>(s.base + pos);
+            const uint64_t size = frame_size(f->topic_len, f->payload_len);
+            if (f->magic != kFrameMagic || pos + size > end) {
+                // frames before it go out first; it is skipped once it is the oldest
+                if (!frames.empty()) break;
+                // torn by an earlier crash; nothing after it in this segment can be trusted
+                logging::warn(logging::Module::kMqtt, "Spool segment {} is corrupt after offset {}, skipping it",
+                              index, pos);
+                store(s.header->read_pos, end);
+                pos = end;
+                continue;
+            }
+            const char* data = reinterpret_cast<const char*>(f + 1);
+            frames.push_back({std::string(data, f->topic_len), std::string(data + f->topic_len, f->payload_len)});
+            pos += size;
+            ends.push_back({index, s.header->generation, pos});
+        }
+    }
+    if (frames.empty()) {
+        return 0;
+    }
+
+    const size_t delivered = std::min(send(frames), frames.size());
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < delivered; i++) {
+        // skip segments append() reused in the meantime
+        SegmentHeader& h = *segments_[ends[i].segment].header;
+        if (h.generation == ends[i].generation && load(h.read_pos) < ends[i].end) {
+            store(h.read_pos, ends[i].end);
+        }
+    }
+    return delivered;
+}
+
+bool TelemetrySpool::empty() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = read_;; i = (i + 1) % segments_.size()) {
+        if (!drained_(i)) return false;
+        if (i == write_) return true;
+    }
+}
+
+uint64_t TelemetrySpool::pending_bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < segments_.size(); i++) {
+        const SegmentHeader& h = *segments_[i].header;
+        bytes += load(h.write_end) - load(h.read_pos);
+    }
+    return bytes;
+}
+
+uint64_t TelemetrySpool::dropped_frames() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dropped_;
+}
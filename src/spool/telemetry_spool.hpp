@@ -0,0 +1,83 @@
+#pragma once
+
+#include "spool_settings.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class TelemetrySpool {
+    // Store-and-forward buffer for telemetry produced while the broker is
+    // unreachable.
+    //
+    // A fixed ring of preallocated segment files in dir, each memory-mapped
+    // once. Frames (topic + payload) are appended to the current segment; when
+    // it is full the next one is reused. If that one still holds frames that
+    // were never replayed, they are dropped and counted, so the spool never
+    // grows beyond the ring. Appending is a memcpy into the mapping, with no
+    // syscall.
+    //
+    // Each segment header records how far it has been written and how far it
+    // has been replayed. Both are updated after the frame bytes, so a spool
+    // left behind by a crashed or killed process is picked up where it
+    // stopped on the next start. Power loss can lose whatever the kernel had
+    // not written back yet.
+  public:
+    // Creates or reopens the ring. Throws std::runtime_error if the directory
+    // or a segment can't be set up.
+    explicit TelemetrySpool(const SpoolSettings& settings);
+    ~TelemetrySpool();
+
+    TelemetrySpool(const TelemetrySpool&) = delete;
+    TelemetrySpool& operator=(const TelemetrySpool&) = delete;
+
+    // False if the frame is larger than a segment
+    bool append(std::string_view topic, std::string_view payload);
+
+    struct Frame {
+        std::string topic;
+        std::string payload;
+    };
+    // Copies up to max_frames of the oldest frames out and hands them to
+    // send, without holding the lock, so append() never waits on the broker.
+    // send returns how many of them, from the front, were delivered; only
+    // those are forgotten, the rest are offered again next time. Frames
+    // dropped by append() while send ran are not brought back. Returns the
+    // number delivered.
+    using Sender = std::function<size_t(const std::vector<Frame>& frames)>;
+    size_t replay(size_t max_frames, const Sender& send);
+
+    bool empty() const;
+    uint64_t pending_bytes() const;
+    uint64_t dropped_frames() const;
+
+  private:
+    struct SegmentHeader;
+    struct Segment {
+        uint8_t* base;
+        SegmentHeader* header;
+    };
+
+    // Where a copied frame ends, to mark it replayed once it is delivered
+    struct FrameEnd {
+        size_t segment;
+        uint64_t generation;
+        uint64_t end;
+    };
+
+    void reset_(size_t index);
+    void advance_write_();
+    bool drained_(size_t index) const;
+
+    mutable std::mutex mutex_;
+    size_t segment_bytes_;
+    std::vector<Segment> segments_;
+    size_t write_ = 0;  // segment being appended to
+    size_t read_ = 0;   // oldest segment that may hold unreplayed frames
+    uint64_t generation_ = 0;
+    uint64_t dropped_ = 0;
+};
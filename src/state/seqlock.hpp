@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <type_traits>
+
+template <typename T>
+class Seqlock {
+    // One value published by writers and copied out by readers without
+    // either side taking a lock the other waits on. A write bumps the
+    // sequence to odd, stores the value, and bumps it back to even; a read
+    // copies the value and retries if the sequence moved or was odd. Writers
+    // are serialized among themselves only. The value is stored as relaxed
+    // atomic words, so the racing copy is well-defined.
+    static_assert(std::is_trivially_copyable_v<T>, "Seqlock values are copied bytewise");
+    static_assert(std::is_default_constructible_v<T>);
+
+  public:
+    Seqlock() { store_(T{}); }
+
+    // Consistent copy of the last completed write. version (if given) is
+    // the number of writes it reflects.
+    T read(uint64_t* version = nullptr) const {
+        T value;
+        while (true) {
+            uint64_t before = seq_.load(std::memory_order_acquire);
+            if (before & 1) {
+                continue; // write in progress
+            }
+            uint64_t words[kWords];
+            for (size_t i = 0; i < kWords; i++) {
+                words[i] = words_[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq_.load(std::memory_order_relaxed) == before) {
+                std::memcpy(&value, words, sizeof(T));
+                if (version) *version = before / 2;
+                return value;
+            }
+        }
+    }
+
+    uint64_t version() const { return seq_.load(std::memory_order_acquire) / 2; }
+
+    void write(const T& value) {
+        std::lock_guard<std::mutex> lock(writer_);
+        store_(value);
+    }
+
+    // Read-modify-write; fn gets the current value and edits it in place.
+    // Atomic with respect to other writers.
+    template <typename Fn>
+    void update(Fn&& fn) {
+        std::lock_guard<std::mutex> lock(writer_);
+        T value = current_();
+        fn(value);
+        store_(value);
+    }
+
+  private:
+    static constexpr size_t kWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    // writer_ held, so nothing else modifies the words
+    T current_() const {
+        uint64_t words[kWords];
+        for (size_t i = 0; i < kWords; i++) {
+            words[i] = words_[i].load(std::memory_order_relaxed);
+        }
+        T value;
+        std::memcpy(&value, words, sizeof(T));
+        return value;
+    }
+
+    void store_(const T& value) {
+        uint64_t words[kWords] = {};
+        std::memcpy(words, &value, sizeof(T));
+        uint64_t seq = seq_.load(std::memory_order_relaxed);
+        seq_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < kWords; i++) {
+            words_[i].store(words[i], std::memory_order_relaxed);
+        }
+        seq_.store(seq + 2, std::memory_order_release);
+    }
+
+    alignas(64) std::atomic<uint64_t> seq_{0};
+    std::atomic<uint64_t> words_[kWords];
+    std::mutex writer_;
+};
@@ -0,0 +1,54 @@
+#include "state_store.hpp"
+
+#include <algorithm>
+
+bool SensorState::find(int hat_id, int channel_id, double& value) const {
+    for (uint32_t i = 0; i < count; i++) {
+        if (samples[i].hat_id == hat_id && samples[i].channel_id == channel_id) {
+            value = samples[i].value;
+            return true;
+        }
+    }
+    return false;
+}
+
+void GpioState::set(int pin, int value) {
+    if (pin < 0 || pin >= 64) return;
+    uint64_t bit = uint64_t(1) << pin;
+    reported |= bit;
+    levels = value ? levels | bit : levels & ~bit;
+}
+
+void GpioState::clear(int pin) {
+    if (pin < 0 || pin >= 64) return;
+    uint64_t bit = uint64_t(1) << pin;
+    reported &= ~bit;
+    levels &= ~bit;
+}
+
+void StateStore::publish_samples(const std::vector<sensor_datapoint>& samples) {
+    SensorState next;
+    next.count = static_cast<uint32_t>(std::min(samples.size(), SensorState::kMaxSamples));
+    std::copy_n(samples.begin(), next.count, next.samples);
+    sensors.write(next);
+}
+
+void StateStore::set_gpio(int pin, int value) {
+    gpio.update([&](GpioState& state) { state.set(pin, value); });
+}
+
+void StateStore::clear_gpio(int pin) {
+    gpio.update([&](GpioState& state) { state.clear(pin); });
+}
+
+void StateStore::set_gpio_inputs(const std::map<int, int>& levels) {
+    GpioState next;
+    for (const auto& [pin, value] : levels) {
+        next.set(pin, value);
+    }
+    gpio.write(next);
+}
+
+void StateStore::set_relays(std::bitset<16> bits) {
+    relays.write(RelayState{static_cast<uint16_t>(bits.to_ulong())});
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "seqlock.hpp"
+
+#include <bitset>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// Device state shared between the threads that produce it (sampler, GPIO
+// monitor, command consumer, servo motion) and the ones that report or act
+// on it (publisher, control loops). Each section is a fixed-size snapshot
+// behind its own Seqlock: readers always get a whole, consistent section and
+// a version number, and a slow reader never holds up a writer.
+
+struct sensor_datapoint {
+    int hat_id;
+    int channel_id;
+    double value;
+    double time; // ms since epoch
+};
+
+struct SensorState {
+    static constexpr size_t kMaxSamples = 64; // 8 MCC128 hats x 8 channels
+    uint32_t count = 0;
+    sensor_datapoint samples[kMaxSamples];
+
+    bool find(int hat_id, int channel_id, double& value) const;
+};
+
+struct GpioState {
+    // Inputs whose level is reported, and their levels; bit n is line n
+    uint64_t reported = 0;
+    uint64_t levels = 0;
+
+    bool has(int pin) const { return pin >= 0 && pin < 64 && (reported >> pin & 1); }
+    int level(int pin) const { return (levels >> pin) & 1; }
+    void set(int pin, int value);
+    void clear(int pin);
+};
+
+struct RelayState {
+    uint16_t bits = 0; // bit n = relay n
+};
+
+struct ServoOutput {
+    uint16_t ticks = 0;   // PCA9685 OFF tick, 0 until first driven
+    float position = 0;   // in the servo's calibrated units
+};
+
+struct ServoState {
+    static constexpr size_t kMaxServos = 128; // eight boards
+    uint32_t count = 0;                      // highest driven id + 1
+    ServoOutput servos[kMaxServos];
+};
+
+class StateStore {
+  public:
+    Seqlock<SensorState> sensors;
+    Seqlock<GpioState> gpio;
+    Seqlock<RelayState> relays;
+    Seqlock<ServoState> servos;
+
+    // Sampler: replaces every sample; extra samples beyond kMaxSamples are
+    // dropped
+    void publish_samples(const std::vector<sensor_datapoint>& samples);
+    // GPIO: one input level, stop reporting a pin, or replace the whole set
+    void set_gpio(int pin, int value);
+    void clear_gpio(int pin);
+    void set_gpio_inputs(const std::map<int, int>& levels);
+    void set_relays(std::bitset<16> bits);
+    std::bitset<16> relay_bits() const { return relays.read().bits; }
+};
@@ -0,0 +1,137 @@
+// Feeds scripted edges to QuadratureEncoder through a stand-in GPIO backend:
+// a full cycle each way, then a repeated edge as a lost one leaves it, which
+// has to be counted as an error and not as a step.
+//
+//     meson test -C build quadrature   (or run quadrature_test directly)
+
+#include "interfaces/quadrature_encoder.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <sys/eventfd.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+constexpr int kPinA = 5;
+constexpr int kPinB = 6;
+
+int failures = 0;
+
+#define CHECK(cond)                                                                    \
+    do {                                                                               \
+        if (!(cond)) {                                                                 \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                                \
+        }                                                                              \
+    } while (0)
+
+// Both lines start low; edges are queued by push() and handed out on one fd
+class ScriptedBackend : public GPIO_Backend {
+  public:
+    ScriptedBackend() : fd_(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) {}
+    ~ScriptedBackend() override { close(fd_); }
+
+    void push(int pin, int value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back({pin, value, ++ts_});
+        uint64_t one = 1;
+        if (::write(fd_, &one, sizeof(one)) < 0) {
+            std::perror("eventfd write");
+        }
+    }
+    bool drained() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return queue_.empty();
+    }
+
+    bool request_outputs(const std::vector<GPIO_LineConfig>&) override { return true; }
+    bool request_inputs(const std::vector<GPIO_LineConfig>&, GPIO_EventClock) override {
+        return true;
+    }
+    void release_outputs() override {}
+    void release_inputs() override {}
+    bool set_outputs(const int*) override { return true; }
+    bool get_inputs(int* levels) override {
+        levels[0] = levels[1] = 0;
+        return true;
+    }
+    std::vector<int> event_fds() override { return {fd_}; }
+    int read_events(int fd, GPIO_Event* events, int max_events) override {
+        uint64_t drained;
+        while (::read(fd, &drained, sizeof(drained)) > 0) {
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        int n = 0;
+        while (n < max_events && !queue_.empty()) {
+            events[n++] = queue_.front();
+            queue_.pop_front();
+        }
+        return n;
+    }
+    bool supports_debounce() const override { return false; }
+
+  private:
+    int fd_;
+    std::mutex mutex_;
+    std::deque<GPIO_Event> queue_;
+    uint64_t ts_ = 0;
+};
+
+// Queues the edges and waits for the decoder to take them and settle
+void feed(ScriptedBackend& backend, const std::vector<GPIO_Event>& edges) {
+    for (const GPIO_Event& e : edges) {
+        backend.push(e.pin, e.value);
+    }
+    for (int i = 0; i < 1000 && !backend.drained(); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    // read_events() empties the queue before apply_() runs on the batch
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CHECK(backend.drained());
+}
+
+} // namespace
+
+int main() {
+    auto owned = std::make_unique<ScriptedBackend>();
+    ScriptedBackend& backend = *owned;
+    QuadratureConfig config;
+    config.pin_a = kPinA;
+    config.pin_b = kPinB;
+    QuadratureEncoder encoder(std::move(owned), config);
+    encoder.start();
+
+    // 00 -> 01 -> 11 -> 10 -> 00 is one cycle forward
+    feed(backend, {{kPinB, 1, 0}, {kPinA, 1, 0}, {kPinB, 0, 0}, {kPinA, 0, 0}});
+    CHECK(encoder.count() == 4);
+    CHECK(encoder.errors() == 0);
+
+    // and back again
+    feed(backend, {{kPinA, 1, 0}, {kPinB, 1, 0}, {kPinA, 0, 0}, {kPinB, 0, 0}});
+    CHECK(encoder.count() == 0);
+    CHECK(encoder.errors() == 0);
+
+    // A falls while already low: the rising edge between was lost
+    feed(backend, {{kPinB, 1, 0}, {kPinA, 0, 0}});
+    CHECK(encoder.count() == 1);
+    CHECK(encoder.errors() == 1);
+
+    // decoding carries on from the levels it knows
+    feed(backend, {{kPinA, 1, 0}, {kPinB, 1, 0}});
+    CHECK(encoder.count() == 2);
+    CHECK(encoder.errors() == 2);
+
+    encoder.stop();
+    if (failures) {
+        std::fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,209 @@
+// Writes a recording through BlackBox and reads it back through
+// RecordingReader: a sealed file, a copy taken mid-run as a crash would
+// leave it, and that copy cut short past its last checkpoint with the
+// header as of that checkpoint, as a power cut would leave it. The reader
+// has to find the blocks written after the checkpoint by following the
+// index chain and scanning the tail.
+//
+//     meson test -C build recording   (or run recording_test directly)
+
+#include "recorder/black_box.hpp"
+#include "recorder/recording_reader.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace recording;
+
+namespace {
+
+constexpr int kChannels = 4;
+constexpr double kStartMs = 1.7e12;
+constexpr double kPassMs = 0.1;
+
+int failures = 0;
+
+#define CHECK(cond)                                                                    \
+    do {                                                                               \
+        if (!(cond)) {                                                                 \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                                \
+        }                                                                              \
+    } while (0)
+
+double pass_ms(size_t pass) { return kStartMs + pass * kPassMs; }
+double value(int channel, size_t pass) { return channel * 1e6 + pass; }
+
+void record_passes(BlackBox& box, size_t from, size_t to) {
+    std::vector<sensor_datapoint> samples(kChannels);
+    for (size_t pass = from; pass < to; pass++) {
+        for (int c = 0; c < kChannels; c++) {
+            samples[c] = {c / 2, c % 2, value(c, pass), pass_ms(pass)};
+        }
+        box.record_samples(samples);
+    }
+}
+
+// Every channel holds passes [0, n) for some n, in order and unchanged, and
+// at least min_passes of them. Returns the smallest n.
+size_t check_samples(const RecordingReader& reader, size_t min_passes) {
+    CHECK(reader.channels().size() == kChannels);
+    size_t shortest = SIZE_MAX;
+    for (int c = 0; c < kChannels; c++) {
+        std::vector<int64_t> times;
+        std::vector<double> values;
+        reader.query(sample_key(c / 2, c % 2), INT64_MIN, INT64_MAX, times, values);
+        CHECK(times.size() >= min_passes);
+        size_t bad = 0;
+        for (size_t i = 0; i < times.size(); i++) {
+            bad += times[i] != std::llround(pass_ms(i) * 1e6) || values[i] != value(c, i);
+        }
+        CHECK(bad == 0);
+        shortest = std::min(shortest, times.size());
+    }
+    return shortest;
+}
+
+// A window in the middle comes back exactly
+void check_window(const RecordingReader& reader, size_t first, size_t last) {
+    std::vector<int64_t> times;
+    std::vector<double> values;
+    reader.query(sample_key(0, 1), std::llround(pass_ms(first) * 1e6), std::llround(pass_ms(last) * 1e6), times,
+                 values);
+    CHECK(times.size() == last - first + 1);
+    CHECK(!values.empty() && values.front() == value(1, first) && values.back() == value(1, last));
+}
+
+size_t count_events(const RecordingReader& reader) {
+    size_t events = 0;
+    reader.query_events(INT64_MIN, INT64_MAX, [&](const RecordingReader::Event&) { events++; });
+    return events;
+}
+
+bool copy_file(const std::string& from, const std::string& to, size_t bytes) {
+    int in = open(from.c_str(), O_RDONLY | O_CLOEXEC);
+    int out = open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    bool ok = in >= 0 && out >= 0;
+    std::vector<char> buffer(kPageSize);
+    for (size_t done = 0; ok && done < bytes; done += kPageSize) {
+        ok = pread(in, buffer.data(), kPageSize, done) == (ssize_t)kPageSize &&
+             pwrite(out, buffer.data(), kPageSize, done) == (ssize_t)kPageSize;
+    }
+    if (in >= 0) close(in);
+    if (out >= 0) close(out);
+    return ok;
+}
+
+} // namespace
+
+int main() {
+    char dir[] = "/tmp/novaground-recording-XXXXXX";
+    if (!mkdtemp(dir)) {
+        std::perror("mkdtemp");
+        return 1;
+    }
+    RecorderSettings settings;
+    settings.dir = dir;
+    settings.size_mb = 16;
+    settings.checkpoint_ms = 3600 * 1000; // checkpoints only when the test takes them
+
+    // enough passes after the checkpoint for new index blocks past it
+    const size_t before = 20000;
+    const size_t after = 60000;
+    const std::string crashed = std::string(dir) + "/crashed.rec";
+    const std::string cut = std::string(dir) + "/cut.rec";
+    std::string path;
+    size_t cut_pages = 0;
+    {
+        BlackBox box(settings, 42);
+        path = box.path();
+        record_passes(box, 0, before);
+        box.record_command("novaground/command", "{\"type\":\"relay\",\"id\":1,\"state\":1}");
+        box.record_gpio(5, 1, 123456789);
+        box.checkpoint();
+
+        FileHeader at_checkpoint;
+        {
+            RecordingReader reader(path);
+            at_checkpoint = reader.header();
+        }
+        record_passes(box, before, before + after);
+        box.record_servo(3, 300, 45.0f);
+
+        // killed here: the file is complete, the header is stale
+        const size_t file_bytes = at_checkpoint.file_bytes;
+        CHECK(copy_file(path, crashed, file_bytes));
+
+        // power cut: only what was on disk at the checkpoint plus half of
+        // what came after made it, and the header is the checkpoint's
+        size_t written;
+        {
+            RecordingReader reader(path);
+            written = reader.end_block();
+        }
+        cut_pages = at_checkpoint.checkpoint_pages + (written - at_checkpoint.checkpoint_pages) / 2;
+        CHECK(copy_file(path, cut, cut_pages * kPageSize));
+        int fd = open(cut.c_str(), O_WRONLY | O_CLOEXEC);
+        CHECK(fd >= 0 && pwrite(fd, &at_checkpoint, sizeof(at_checkpoint), 0) == (ssize_t)sizeof(at_checkpoint));
+        if (fd >= 0) close(fd);
+    }
+
+    try {
+        RecordingReader sealed(path);
+        CHECK(sealed.header().closed == 1);
+        CHECK(sealed.header().run_id == 42);
+        CHECK(check_samples(sealed, before + after) == before + after);
+        check_window(sealed, before - 1000, before + 1000);
+        CHECK(count_events(sealed) == 3);
+
+        RecordingReader killed(crashed);
+        CHECK(killed.header().closed == 0);
+        CHECK(check_samples(killed, before + after) == before + after);
+        CHECK(count_events(killed) == 3);
+
+        RecordingReader power_cut(cut);
+        CHECK(power_cut.header().closed == 0);
+        CHECK(power_cut.end_block() <= cut_pages);
+        // the cut part must include an index block the header doesn't know
+        bool newer_index = false;
+        for (size_t page = power_cut.header().checkpoint_pages; page < power_cut.end_block(); page++) {
+            newer_index |= power_cut.block(page).type == static_cast<uint16_t>(BlockType::kIndex);
+        }
+        CHECK(newer_index);
+        check_samples(power_cut, before);
+        // every sample in a page that survived the cut is found
+        for (uint16_t key : killed.channels()) {
+            size_t expected = 0;
+            for (const auto& ref : killed.blocks(key)) {
+                if (ref.page < power_cut.end_block()) expected += RecordingReader::sample_count(killed.block(ref.page));
+            }
+            std::vector<int64_t> times;
+            std::vector<double> values;
+            CHECK(power_cut.query(key, INT64_MIN, INT64_MAX, times, values) == expected);
+        }
+        check_window(power_cut, before - 1000, before + 1000);
+        CHECK(count_events(power_cut) >= 2);
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        failures++;
+    }
+
+    unlink(path.c_str());
+    unlink(crashed.c_str());
+    unlink(cut.c_str());
+    rmdir(dir);
+    if (failures) {
+        std::fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,93 @@
+// Drives a simulated PCA9685 through ServoMotion, browns the chip out so it
+// comes back on its power-on prescale with every output off, and checks that
+// after ServoMotion::resync() the servo is driven at the commanded pulse width
+// again, in ticks of the new prescale.
+//
+//     meson test -C build servo_resync   (or run servo_resync_test directly)
+
+#include "control/servo_motion.hpp"
+#include "hal/sim_pwm_driver.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <thread>
+
+namespace {
+
+constexpr double kCommandUs = 1500;
+
+int failures = 0;
+
+#define CHECK(cond)                                                                    \
+    do {                                                                               \
+        if (!(cond)) {                                                                 \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                                \
+        }                                                                              \
+    } while (0)
+
+// Within one tick of the prescale the chip is running now
+bool near_command(SimPwmDriver& chip) {
+    double us_per_tick = 1e6 * (chip.readPrescale() + 1) / chip.getOscillatorFrequency();
+    double out = chip.outputMicroseconds(0);
+    if (std::abs(out - kCommandUs) > us_per_tick) {
+        std::fprintf(stderr, "output %.1f us, commanded %.1f us\n", out, kCommandUs);
+        return false;
+    }
+    return true;
+}
+
+// A few frames at whichever rate the board runs
+void settle() { std::this_thread::sleep_for(std::chrono::milliseconds(200)); }
+
+} // namespace
+
+int main() {
+    SimSettings settings;
+    settings.i2c_hz = 0;
+    SimPwmDriver* chip = nullptr;
+    ServoBank bank;
+    size_t ready = bank.begin({ServoBoardConfig{}}, [&](uint8_t address) {
+        auto driver = std::make_unique<SimPwmDriver>(settings, address);
+        chip = driver.get();
+        return driver;
+    });
+    CHECK(ready == 1);
+    if (!chip) return 1;
+
+    ServoMotion motion(bank);
+    MotionLimits limits;
+    limits.profile = MotionProfile::kStep;
+    motion.set_limits(0, limits);
+    motion.start();
+
+    CHECK(motion.set_target(0, kCommandUs));
+    settle();
+    const uint8_t configured = chip->readPrescale();
+    CHECK(std::abs(chip->getPWMFreq() - 50) < 1);
+    CHECK(near_command(*chip));
+
+    // back at 0x1E (about 200 Hz), outputs full off, shadow unaware
+    chip->brownOut();
+    CHECK(chip->outputMicroseconds(0) == 0);
+    CHECK(!motion.resync());
+    CHECK(chip->readPrescale() == 0x1E);
+    CHECK(chip->readPrescale() != configured);
+    settle();
+    CHECK(near_command(*chip));
+
+    // later commands use the rebuilt table too
+    CHECK(motion.set_target(0, kCommandUs + 200));
+    settle();
+    double us_per_tick = 1e6 * (chip->readPrescale() + 1) / chip->getOscillatorFrequency();
+    CHECK(std::abs(chip->outputMicroseconds(0) - (kCommandUs + 200)) <= us_per_tick);
+
+    motion.stop();
+    if (failures) {
+        std::fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
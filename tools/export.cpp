@@ -0,0 +1,345 @@
+// Converts a black-box recording to CSV or raw columns for analysis, on every
+// core.
+//
+//     novaground-export RECORDING --out DIR [--format csv|columns] [--config novaground.json]
+//                       [--channel 0:3[,1:0...]] [--from S] [--to S] [--t0 UNIX_S] [--threads N]
+//
+// csv writes DIR/<name>.csv per channel ("time_s,<name> (<unit>)", time
+// relative to t0). columns writes DIR/<name>.time.i64 (int64 ns since the
+// epoch) and DIR/<name>.value.f64 (float64), plus DIR/manifest.json listing
+// them. Values are calibrated with daq.calibration from --config; channels
+// without one stay in volts. <name> is the calibration name, or hat<H>_ch<C>
+// without one; channels that share a name get _hat<H>_ch<C> appended. t0
+// defaults to the start of the recording.
+//
+// Each channel's blocks are cut into chunks that a pool of threads converts
+// and writes independently. A chunk's place in the output file is handed out
+// in order once the chunk before it knows its size, so only that handoff is
+// serialized; formatting and the writes themselves run in parallel.
+
+#include "config/config.hpp"
+#include "recorder/recording_reader.hpp"
+#include "recorder/recording_window.hpp"
+
+#include <boost/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cerrno>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace recording;
+
+namespace {
+
+constexpr size_t kBlocksPerChunk = 64; // ~16k samples
+
+[[noreturn]] void usage(const char* argv0) {
+    std::fprintf(stderr,
+                 "usage: %s RECORDING --out DIR [--format csv|columns] [--config FILE]\n"
+                 "       [--channel HAT:CH[,HAT:CH...]] [--from S] [--to S] [--t0 UNIX_S] [--threads N]\n",
+                 argv0);
+    std::exit(2);
+}
+
+// value = volts * scale + offset for a whole column. Kept to a plain loop
+// over non-aliasing arrays so the compiler vectorizes it.
+void calibrate(const double* __restrict volts, double* __restrict out, size_t n, double scale, double offset) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = volts[i] * scale + offset;
+    }
+}
+
+void to_seconds(const int64_t* __restrict ns, double* __restrict out, size_t n, int64_t t0_ns) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = static_cast<double>(ns[i] - t0_ns) * 1e-9;
+    }
+}
+
+bool write_all(int fd, const void* data, size_t bytes, uint64_t offset) {
+    const char* p = static_cast<const char*>(data);
+    while (bytes) {
+        ssize_t n = pwrite(fd, p, bytes, offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += n;
+        bytes -= n;
+        offset += n;
+    }
+    return true;
+}
+
+int create(const std::string& path) {
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("cannot create " + path + ": " + std::strerror(errno));
+    }
+    return fd;
+}
+
+using BlockRef = RecordingReader::BlockRef;
+
+// One channel's output files and how far they have been handed out
+struct Output {
+    uint16_t key;
+    ChannelCalibration calibration;
+    int fd = -1;       // csv, or the time column
+    int value_fd = -1; // value column
+    std::vector<BlockRef> blocks;
+
+    std::mutex mutex;
+    std::condition_variable turn;
+    size_t next_chunk = 0;
+    uint64_t end = 0;     // bytes (csv) or samples (columns) handed out so far
+
+    // Waits for chunk's turn, then takes size units at the current end
+    uint64_t reserve(size_t chunk, uint64_t size) {
+        std::unique_lock<std::mutex> lock(mutex);
+        turn.wait(lock, [&] { return next_chunk == chunk; });
+        uint64_t offset = end;
+        end += size;
+        next_chunk++;
+        turn.notify_all();
+        return offset;
+    }
+};
+
+struct Chunk {
+    Output* output;
+    size_t index;       // within the channel
+    size_t first, last; // blocks [first, last) of output->blocks
+};
+
+struct Job {
+    const RecordingReader* reader;
+    bool csv;
+    int64_t t0_ns, from_ns, to_ns;
+    std::vector<Chunk> chunks;
+    std::atomic<size_t> next{0};
+    std::atomic<uint64_t> samples{0};
+    std::atomic<bool> failed{false};
+};
+
+void convert(Job& job, const Chunk& chunk) {
+    Output& out = *chunk.output;
+    std::vector<int64_t> times;
+    std::vector<double> volts;
+    times.reserve((chunk.last - chunk.first) * kSamplesPerBlock);
+    volts.reserve(times.capacity());
+    for (size_t b = chunk.first; b < chunk.last; b++) {
+        const BlockHeader& block = job.reader->block(out.blocks[b].page);
+        const int64_t* t = sample_times(&block);
+        const double* v = sample_values(&block);
+        const size_t n = RecordingReader::sample_count(block);
+        const size_t lo = std::lower_bound(t, t + n, job.from_ns) - t;
+        const size_t hi = std::upper_bound(t, t + n, job.to_ns) - t;
+        if (lo >= hi) continue;
+        times.insert(times.end(), t + lo, t + hi);
+        volts.insert(volts.end(), v + lo, v + hi);
+    }
+    const size_t n = times.size();
+    std::vector<double> values(n);
+    calibrate(volts.data(), values.data(), n, out.calibration.scale, out.calibration.offset);
+    job.samples += n;
+
+    bool ok;
+    if (!job.csv) {
+        const uint64_t at = out.reserve(chunk.index, n);
+        ok = write_all(out.fd, times.data(), n * sizeof(int64_t), at * sizeof(int64_t)) &&
+             write_all(out.value_fd, values.data(), n * sizeof(double), at * sizeof(double));
+    } else {
+        std::vector<double> seconds(n);
+        to_seconds(times.data(), seconds.data(), n, job.t0_ns);
+        std::string text(n * 48, '\0');
+        char* p = text.data();
+        char* const end = p + text.size();
+        for (size_t i = 0; i < n; i++) {
+            p = std::to_chars(p, end, seconds[i], std::chars_format::fixed, 9).ptr;
+            *p++ = ',';
+            p = std::to_chars(p, end, values[i]).ptr;
+            *p++ = '\n';
+        }
+        const size_t bytes = p - text.data();
+        const uint64_t at = out.reserve(chunk.index, bytes);
+        ok = write_all(out.fd, text.data(), bytes, at);
+    }
+    if (!ok) {
+        std::fprintf(stderr, "write failed: %s\n", std::strerror(errno));
+        job.failed = true;
+    }
+}
+
+void worker(Job& job) {
+    for (size_t i; (i = job.next++) < job.chunks.size();) {
+        convert(job, job.chunks[i]);
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string path, out_dir, format = "csv", config_file, channels;
+    double from_s = -std::numeric_limits<double>::infinity();
+    double to_s = std::numeric_limits<double>::infinity();
+    double t0_s = NAN;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) usage(argv[0]);
+            return argv[++i];
+        };
+        if (arg == "--out") out_dir = value();
+        else if (arg == "--format") format = value();
+        else if (arg == "--config") config_file = value();
+        else if (arg == "--channel") channels = value();
+        else if (arg == "--from") from_s = std::atof(value().c_str());
+        else if (arg == "--to") to_s = std::atof(value().c_str());
+        else if (arg == "--t0") t0_s = std::atof(value().c_str());
+        else if (arg == "--threads") threads = std::max(1, std::atoi(value().c_str()));
+        else if (arg.rfind("--", 0) != 0 && path.empty()) path = arg;
+        else usage(argv[0]);
+    }
+    if (path.empty() || out_dir.empty() || (format != "csv" && format != "columns")) usage(argv[0]);
+
+    std::vector<uint16_t> keys;
+    std::string bad;
+    if (!parse_channels(channels, keys, bad)) {
+        std::fprintf(stderr, "bad channel '%s', expected HAT:CHANNEL\n", bad.c_str());
+        return 2;
+    }
+
+    RuntimeConfig config;
+    std::string error;
+    if (!config_file.empty() && !load_config(config_file, config, error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    try {
+        const auto started = std::chrono::steady_clock::now();
+        RecordingReader reader(path);
+        if (mkdir(out_dir.c_str(), 0755) != 0 && errno != EEXIST) {
+            throw std::runtime_error("cannot create " + out_dir + ": " + std::strerror(errno));
+        }
+
+        Job job;
+        job.reader = &reader;
+        job.csv = format == "csv";
+        job.t0_ns = std::isnan(t0_s) ? reader.header().created_ns : std::llround(t0_s * 1e9);
+        job.from_ns = window_ns(job.t0_ns, from_s);
+        job.to_ns = window_ns(job.t0_ns, to_s);
+        if (keys.empty()) keys = reader.channels();
+        // output names come from the calibration; channels sharing one get
+        // their hat and channel appended so no file is written twice
+        std::map<std::string, int> name_uses;
+        auto channel_name = [&](uint16_t key) {
+            auto cal = config.daq.calibration.find(key);
+            return cal != config.daq.calibration.end() && !cal->second.name.empty()
+                       ? cal->second.name
+                       : "hat" + std::to_string(key_hat(key)) + "_ch" + std::to_string(key_channel(key));
+        };
+        for (uint16_t key : keys) name_uses[channel_name(key)]++;
+
+        // one Output per channel, only the blocks that overlap the window
+        std::vector<std::unique_ptr<Output>> outputs;
+        for (uint16_t key : keys) {
+            auto out = std::make_unique<Output>();
+            out->key = key;
+            auto cal = config.daq.calibration.find(key);
+            if (cal != config.daq.calibration.end()) out->calibration = cal->second;
+            out->calibration.name = channel_name(key);
+            if (name_uses[out->calibration.name] > 1) {
+                out->calibration.name += "_hat" + std::to_string(key_hat(key)) + "_ch" + std::to_string(key_channel(key));
+            }
+            const auto& refs = reader.blocks(key);
+            for (size_t i = 0; i < refs.size(); i++) {
+                const bool before = i + 1 < refs.size() && refs[i + 1].first_ns <= job.from_ns;
+                if (!before && refs[i].first_ns <= job.to_ns) out->blocks.push_back(refs[i]);
+            }
+
+            const std::string base = out_dir + "/" + out->calibration.name;
+            if (job.csv) {
+                out->fd = create(base + ".csv");
+                const std::string header =
+                    "time_s," + out->calibration.name + " (" + out->calibration.unit + ")\n";
+                if (!write_all(out->fd, header.data(), header.size(), 0)) {
+                    throw std::runtime_error("cannot write " + base + ".csv");
+                }
+                out->end = header.size();
+            } else {
+                out->fd = create(base + ".time.i64");
+                out->value_fd = create(base + ".value.f64");
+            }
+            for (size_t first = 0, index = 0; first < out->blocks.size(); first += kBlocksPerChunk, index++) {
+                job.chunks.push_back({out.get(), index, first, std::min(first + kBlocksPerChunk, out->blocks.size())});
+            }
+            outputs.push_back(std::move(out));
+        }
+        // interleave the channels so every thread starts on a different file
+        std::stable_sort(job.chunks.begin(), job.chunks.end(),
+                         [](const Chunk& a, const Chunk& b) { return a.index < b.index; });
+
+        std::vector<std::thread> pool;
+        for (unsigned i = 0; i < threads; i++) pool.emplace_back(worker, std::ref(job));
+        for (auto& t : pool) t.join();
+
+        uint64_t bytes = 0;
+        boost::json::array manifest_channels;
+        for (const auto& out : outputs) {
+            bytes += job.csv ? out->end : out->end * (sizeof(int64_t) + sizeof(double));
+            if (!job.csv) {
+                const std::string base = out->calibration.name;
+                manifest_channels.push_back({{"hat", key_hat(out->key)},
+                                             {"channel", key_channel(out->key)},
+                                             {"name", out->calibration.name},
+                                             {"unit", out->calibration.unit},
+                                             {"scale", out->calibration.scale},
+                                             {"offset", out->calibration.offset},
+                                             {"samples", out->end},
+                                             {"time", base + ".time.i64"},
+                                             {"value", base + ".value.f64"}});
+            }
+            if (out->fd >= 0) close(out->fd);
+            if (out->value_fd >= 0) close(out->value_fd);
+        }
+        if (!job.csv) {
+            boost::json::object manifest{{"run", reader.header().run_id},
+                                         {"t0_ns", job.t0_ns},
+                                         {"time", "int64 ns since the Unix epoch, little-endian"},
+                                         {"value", "float64, little-endian"},
+                                         {"channels", manifest_channels}};
+            const std::string text = boost::json::serialize(manifest) + "\n";
+            int fd = create(out_dir + "/manifest.json");
+            bool ok = write_all(fd, text.data(), text.size(), 0);
+            close(fd);
+            if (!ok) throw std::runtime_error("cannot write manifest.json");
+        }
+
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        std::fprintf(stderr, "%zu channels, %llu samples, %.1f MB in %.2f s on %u threads\n", outputs.size(),
+                     static_cast<unsigned long long>(job.samples.load()), bytes / 1e6, seconds, threads);
+        return job.failed ? 1 : 0;
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
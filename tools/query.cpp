@@ -0,0 +1,211 @@
+// Pulls a time window out of a black-box recording without reading the rest
+// of it.
+//
+//     novaground-query RECORDING
+//         what is in it: run, state, channels and the time each one spans
+//     novaground-query RECORDING --channel 0:3[,1:0...] --from -2 --to 5 [--t0 SECONDS] [--events]
+//                                [--out PREFIX]
+//         samples of those channels (hat:channel) from t0-2 s to t0+5 s as
+//         CSV on stdout, or with --out as raw columns, PREFIX_<hat>_<channel>.time.i64
+//         (int64 ns since the epoch) and .value.f64; --events adds the
+//         commands and actuator changes in the window as a CSV table of their
+//         own, after the samples on stdout or in PREFIX_events.csv
+//
+// t0 is a Unix time in seconds and defaults to the start of the recording.
+
+#include "recorder/recording_reader.hpp"
+#include "recorder/recording_window.hpp"
+
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace recording;
+
+namespace {
+
+[[noreturn]] void usage(const char* argv0) {
+    std::fprintf(stderr,
+                 "usage: %s RECORDING [--channel HAT:CH[,HAT:CH...]] [--from S] [--to S] [--t0 UNIX_S]\n"
+                 "       [--events] [--out PREFIX]\n",
+                 argv0);
+    std::exit(2);
+}
+
+double seconds(int64_t ns, int64_t t0_ns) { return (ns - t0_ns) / 1e9; }
+
+void summary(const RecordingReader& reader) {
+    const FileHeader& h = reader.header();
+    std::printf("run %" PRIu64 ", %s, %zu blocks, %" PRIu64 " dropped\n", h.run_id,
+                h.closed ? "closed" : "cut short", reader.end_block() - 1, h.dropped);
+    for (uint16_t key : reader.channels()) {
+        const auto& refs = reader.blocks(key);
+        const BlockHeader& last = reader.block(refs.back().page);
+        std::printf("  %d:%d  %zu blocks  %.3f s .. %.3f s\n", key_hat(key), key_channel(key), refs.size(),
+                    seconds(refs.front().first_ns, h.created_ns), seconds(last.last_ns, h.created_ns));
+    }
+    std::printf("  events  %zu blocks\n", reader.blocks(kEventsKey).size());
+}
+
+// Events share one layout whatever their kind, under their own header:
+//     time_s,kind,target,value,detail
+// command: topic, -, message; relay: -, bits, -; servo: id, ticks, position;
+// gpio: pin, level, -
+constexpr const char* kEventHeader = "time_s,kind,target,value,detail\n";
+
+// Quoted, with embedded quotes doubled
+void put_quoted(std::string_view text, FILE* f) {
+    std::fputc('"', f);
+    for (char c : text) {
+        if (c == '"') std::fputc('"', f);
+        std::fputc(c, f);
+    }
+    std::fputc('"', f);
+}
+
+void print_event(const RecordingReader::Event& event, int64_t t0_ns, FILE* f) {
+    std::fprintf(f, "%.9f,", seconds(event.time_ns, t0_ns));
+    switch (event.kind) {
+    case EventKind::kCommand: {
+        CommandEvent command;
+        std::memcpy(&command, event.body.data(), sizeof(command));
+        std::string_view rest = event.body.substr(sizeof(command));
+        std::fprintf(f, "command,");
+        put_quoted(rest.substr(0, command.topic_length), f);
+        std::fprintf(f, ",,");
+        put_quoted(rest.substr(command.topic_length), f);
+        std::fprintf(f, "\n");
+        break;
+    }
+    case EventKind::kRelay: {
+        RelayEvent relay;
+        std::memcpy(&relay, event.body.data(), sizeof(relay));
+        std::fprintf(f, "relay,,0x%04x,\n", relay.bits);
+        break;
+    }
+    case EventKind::kServo: {
+        ServoEvent servo;
+        std::memcpy(&servo, event.body.data(), sizeof(servo));
+        std::fprintf(f, "servo,%u,%u,%g\n", servo.id, servo.ticks, servo.position);
+        break;
+    }
+    case EventKind::kGpio: {
+        GpioEvent gpio;
+        std::memcpy(&gpio, event.body.data(), sizeof(gpio));
+        std::fprintf(f, "gpio,%d,%d,\n", gpio.pin, gpio.value);
+        break;
+    }
+    default:
+        std::fprintf(f, "unknown,,,\n");
+    }
+}
+
+bool write_column(const std::string& path, const void* data, size_t bytes) {
+    FILE* f = std::fopen(path.c_str(), "wb");
+    bool ok = f && std::fwrite(data, 1, bytes, f) == bytes;
+    if (f && std::fclose(f) != 0) ok = false;
+    if (!ok) std::fprintf(stderr, "cannot write %s\n", path.c_str());
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string path, channels, out;
+    double from_s = -std::numeric_limits<double>::infinity();
+    double to_s = std::numeric_limits<double>::infinity();
+    double t0_s = NAN;
+    bool events = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) usage(argv[0]);
+            return argv[++i];
+        };
+        if (arg == "--channel") channels = value();
+        else if (arg == "--from") from_s = std::atof(value().c_str());
+        else if (arg == "--to") to_s = std::atof(value().c_str());
+        else if (arg == "--t0") t0_s = std::atof(value().c_str());
+        else if (arg == "--events") events = true;
+        else if (arg == "--out") out = value();
+        else if (arg.rfind("--", 0) != 0 && path.empty()) path = arg;
+        else usage(argv[0]);
+    }
+    if (path.empty()) usage(argv[0]);
+
+    try {
+        RecordingReader reader(path);
+        if (channels.empty() && !events) {
+            summary(reader);
+            return 0;
+        }
+
+        const int64_t t0_ns = std::isnan(t0_s) ? reader.header().created_ns : std::llround(t0_s * 1e9);
+        const int64_t from_ns = window_ns(t0_ns, from_s);
+        const int64_t until_ns = window_ns(t0_ns, to_s);
+        std::vector<uint16_t> keys;
+        std::string bad;
+        if (!parse_channels(channels, keys, bad)) {
+            std::fprintf(stderr, "bad channel '%s', expected HAT:CHANNEL\n", bad.c_str());
+            return 2;
+        }
+
+        if (out.empty() && !keys.empty()) std::printf("channel,time_s,value\n");
+        for (uint16_t key : keys) {
+            std::vector<int64_t> times;
+            std::vector<double> values;
+            reader.query(key, from_ns, until_ns, times, values);
+            if (!out.empty()) {
+                const std::string prefix = out + "_" + std::to_string(key_hat(key)) + "_" + std::to_string(key_channel(key));
+                if (!write_column(prefix + ".time.i64", times.data(), times.size() * sizeof(int64_t)) ||
+                    !write_column(prefix + ".value.f64", values.data(), values.size() * sizeof(double))) {
+                    return 1;
+                }
+                std::fprintf(stderr, "%s: %zu samples\n", prefix.c_str(), times.size());
+                continue;
+            }
+            for (size_t i = 0; i < times.size(); i++) {
+                std::printf("%d:%d,%.9f,%.9g\n", key_hat(key), key_channel(key), seconds(times[i], t0_ns), values[i]);
+            }
+        }
+        if (events) {
+            // a table of its own: after a blank line on stdout, or PREFIX_events.csv
+            FILE* f = stdout;
+            const std::string events_path = out + "_events.csv";
+            if (!out.empty()) {
+                f = std::fopen(events_path.c_str(), "w");
+                if (!f) {
+                    std::fprintf(stderr, "cannot write %s\n", events_path.c_str());
+                    return 1;
+                }
+            } else if (!keys.empty()) {
+                std::printf("\n");
+            }
+            std::fputs(kEventHeader, f);
+            size_t count = 0;
+            reader.query_events(from_ns, until_ns, [&](const RecordingReader::Event& e) {
+                print_event(e, t0_ns, f);
+                count++;
+            });
+            if (f != stdout) {
+                bool ok = !std::ferror(f);
+                if (std::fclose(f) != 0 || !ok) {
+                    std::fprintf(stderr, "cannot write %s\n", events_path.c_str());
+                    return 1;
+                }
+                std::fprintf(stderr, "%s: %zu events\n", events_path.c_str(), count);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}